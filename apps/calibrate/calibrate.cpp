@@ -24,6 +24,7 @@ namespace fs = boost::filesystem;
 namespace default_values{
     static const float features_conf_thresh = 0.65;
     static const std::string adjustor_type = "ray";
+    static const double work_megapix = -1;
 }
 namespace options_parser{
     static const std::map<std::string, laz::BundleAdjustor> adjustor_type = {
@@ -55,6 +56,8 @@ static void printUsage(){
               "                              Specify the path to the intrinsic calibration json that contains \n"
               "                              intrinsic parameters, dist_coeffs and dimensions for each registered \n"
               "                              cameras.\n"
+              "                              Cameras listing their 'neighbors' are only matched with them, \n"
+              "                              which speeds up the calibration of large rigs.\n"
               "\n"
               "  --dataset_path        [-d]  MANDATORY\n"
               "                              Specify the path of the json file that contains the paths to the \n"
@@ -72,6 +75,15 @@ static void printUsage(){
               "                              DEFAULT: " << default_values::adjustor_type << "\n"
               "                              Specify the OpenCV Bundle Adjustor Type Used for features matching.\n"
               "                              Options: " << format_adjustor_options() << " \n"
+              "\n"
+              "  --work_megapix              OPTIONAL\n"
+              "                              DEFAULT: " << default_values::work_megapix << "\n"
+              "                              Specify the resolution, in megapixels, of features extraction, matching and \n"
+              "                              bundle adjustment. Full resolution is used if <= 0.\n"
+              "\n"
+              "  --refine_full_res           OPTIONAL\n"
+              "                              Detect and match the features again on the full resolution images, around the \n"
+              "                              inlier matches found at --work_megapix, and adjust the calibration on them.\n"
               "\n\n";
 }
 
@@ -85,6 +97,8 @@ int main(int argc, char** argv){
     // Optional Parameters
     float features_conf_thresh = default_values::features_conf_thresh;
     laz::BundleAdjustor adjustor = options_parser::adjustor_type.at(default_values::adjustor_type);
+    double work_megapix = default_values::work_megapix;
+    bool refine_full_res = false;
 
     std::set<std::string> unused_param = {"--calibration_path", "--dataset_path", "--output_path"};
 
@@ -132,6 +146,13 @@ int main(int argc, char** argv){
             }
             adjustor = options_parser::adjustor_type.at(argv[i]);
         }
+        else if (std::string(argv[i]) == "--work_megapix" ){
+            i++;
+            work_megapix = std::stod(argv[i]);
+        }
+        else if (std::string(argv[i]) == "--refine_full_res" ){
+            refine_full_res = true;
+        }
         else
         {
             std::string error_msg = "Unknown parameter '" + std::string(argv[i]) + "'." + std::to_string(i);
@@ -149,6 +170,7 @@ int main(int argc, char** argv){
     // Parse intrinsic_calib_path
     std::vector<laz::CameraCalibration*> calib_cams = laz::load_calibration_cams(
             calibration_path.string(), dataset_path.string());
+    cv::Mat match_mask = laz::load_match_mask(calibration_path.string(), calib_cams);
 
     std::vector<std::string> exist_names;
     for(int i=0;i<calib_cams.size();i++)
@@ -164,8 +186,8 @@ int main(int argc, char** argv){
         exist_names.push_back(cam_name);
     }
 
-    laz::Calibrator calibrator(features_conf_thresh, adjustor);
-    std::vector<laz::RotationCamera> calibrated_cams = calibrator.calibrate(calib_cams);
+    laz::Calibrator calibrator(features_conf_thresh, adjustor, work_megapix, refine_full_res);
+    std::vector<laz::RotationCamera> calibrated_cams = calibrator.calibrate(calib_cams, match_mask);
 
     nlohmann::json calibration_outfile;
     nlohmann::json& cam_json = calibration_outfile["cameras"];
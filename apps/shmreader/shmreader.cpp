@@ -0,0 +1,125 @@
+#include <iostream>
+#include <string>
+#include <chrono>
+#include <thread>
+#include <set>
+
+#include <opencv2/core.hpp>
+#include <opencv2/highgui.hpp>
+
+#include <plog/Log.h>
+#include <plog/Init.h>
+#include <plog/Formatters/TxtFormatter.h>
+#include <plog/Appenders/ColorConsoleAppender.h>
+
+#include "core/shmring.h"
+
+namespace default_values{
+    // Optional Parameters
+    static const int timeout_ms = 2000;
+    static const bool display = false;
+}
+
+static void printUsage(){
+    std::cout <<
+              "[Shared Memory Mosaic Reader] \n"
+              "This tool reads in place the mosaics published by the stitch app in a shared memory ring \n"
+              "(--shm_ring) and reports their latency. It is an example of downstream consumer.\n"
+              "\n"
+              "FLAGS\n"
+              "  --help                [-h]  Display this message.\n"
+              "\n"
+              "  --shm_ring            [-r]  MANDATORY\n"
+              "                              Name of the shared memory ring, ex. '/laz_mosaic'. \n"
+              "\n"
+              "  --timeout_ms                OPTIONAL\n"
+              "                              DEFAULT: " << default_values::timeout_ms << "\n"
+              "                              Stop after this delay without a new mosaic. \n"
+              "\n"
+              "  --display                   OPTIONAL\n"
+              "                              DEFAULT: " << default_values::display << "\n"
+              "                              Show the mosaics in a window. \n"
+              "\n\n";
+}
+
+int main(int argc, char** argv) {
+    static plog::ConsoleAppender<plog::TxtFormatter> consoleAppender;
+    plog::init(plog::debug, &consoleAppender);
+
+    // Mandatory Parameters
+    std::string shm_ring;
+
+    // Optional Parameters
+    int timeout_ms = default_values::timeout_ms;
+    bool display = default_values::display;
+
+    std::set<std::string> unused_param = {"--shm_ring"};
+
+    if (argc == 1) {
+        printUsage();
+        return EXIT_FAILURE;
+    }
+    for (int i = 1; i < argc; ++i) {
+        if (std::string(argv[i]) == "--help" || std::string(argv[i]) == "-h"){
+            printUsage();
+            return 0;
+        }
+        else if (std::string(argv[i]) == "--shm_ring" || std::string(argv[i]) == "-r"){
+            i++;
+            shm_ring = std::string(argv[i]);
+            unused_param.erase("--shm_ring");
+        }
+        else if (std::string(argv[i]) == "--timeout_ms"){
+            i++;
+            timeout_ms = std::atoi(argv[i]);
+        }
+        else if (std::string(argv[i]) == "--display"){
+            display = true;
+        }
+        else
+        {
+            std::string error_msg = "Unknown parameter '" + std::string(argv[i]) + "'.";
+            throw std::runtime_error(error_msg);
+        }
+    }
+
+    if (!unused_param.empty()){
+        std::string error_msg = "One or more mandatory parameters have not been set:\n";
+        for (const auto& param : unused_param)
+            error_msg += "\t" + param + "\n";
+        throw std::runtime_error(error_msg);
+    }
+
+    laz::ShmRingReader reader(shm_ring);
+    laz::ShmFrame frame;
+    long nr_frames = 0;
+    while (reader.read(frame, timeout_ms))
+    {
+        const int64_t now_us = std::chrono::duration_cast<std::chrono::microseconds>(
+                std::chrono::steady_clock::now().time_since_epoch()).count();
+
+        // frame.image points into the ring: consume it before checking that it was not overwritten
+        cv::Mat preview;
+        if (display)
+            frame.image.convertTo(preview, CV_8U);
+
+        if (!reader.is_valid(frame))
+        {
+            PLOGW << "Mosaic " << frame.seq << " overwritten while being read.";
+            continue;
+        }
+        nr_frames++;
+        PLOGD << "Mosaic " << frame.seq << " (" << frame.image.cols << "x" << frame.image.rows << ") read "
+              << (now_us - frame.timestamp_us) / 1000. << " ms after publication, "
+              << reader.get_nr_dropped() << " dropped so far.";
+
+        if (display)
+        {
+            cv::imshow(shm_ring, preview);
+            if (cv::waitKey(1) == 27)
+                break;
+        }
+    }
+    PLOGI << "Read " << nr_frames << " mosaics, dropped " << reader.get_nr_dropped() << ".";
+    return 0;
+}
@@ -1,5 +1,7 @@
 #include <assert.h>
 #include <set>
+#include <fstream>
+#include <chrono>
 
 #include <plog/Log.h>
 #include <plog/Init.h>
@@ -8,6 +10,8 @@
 
 #include "dataloader/dataloader.h"
 #include "stitching/stitcher.h"
+#include "stitching/outputsink.h"
+#include "core/framepool.h"
 
 namespace fs = boost::filesystem;
 
@@ -17,6 +21,26 @@ namespace default_values{
     static const bool do_update_seams = false;
     static const float scale_factor = 1.0f;
     static const float blend_strength = 5.0f;
+    static const bool compact_maps = false;
+    static const int prefetch_depth = 0;
+    static const int read_workers = 0;
+    static const std::string blender_type = "feather";
+    static const bool async_seams = false;
+    static const int exposure_cadence = 0;
+    static const float exposure_smoothing = 1.0f;
+    static const int pipeline_depth = 0;
+    static const std::string sink_type = "png";
+    static const std::string sink_path = "mosaic";
+    static const int jpeg_quality = 95;
+    static const std::string video_codec = "MJPG";
+    static const double video_fps = 30.;
+    static const int sink_queue = 4;
+    static const std::string shm_ring = "";
+    static const int shm_slots = 4;
+    static const bool frame_pool = false;
+    static const int stats_interval = 0;
+    static const std::string stats_path = "stitcher_stats.json";
+    static const std::string map_cache = "";
 }
 
 static void printUsage(){
@@ -53,6 +77,105 @@ static void printUsage(){
               "                              DEFAULT: " << default_values::scale_factor << "\n"
               "                              Camera scaling factor. Used to reduce memory consumption.\n"
               "                              Must be withing this interval: ]0, 1]. \n"
+              "\n"
+              "  --compact_maps              OPTIONAL\n"
+              "                              DEFAULT: " << default_values::compact_maps << "\n"
+              "                              Use fixed-point remap tables (CV_16SC2). Reduces the remapping memory \n"
+              "                              bandwidth at a 1/32 pixel precision. \n"
+              "\n"
+              "  --prefetch_depth            OPTIONAL\n"
+              "                              DEFAULT: " << default_values::prefetch_depth << "\n"
+              "                              Number of frames decoded and remapped ahead by a background worker \n"
+              "                              for each camera stream. 0 disables prefetching. \n"
+              "\n"
+              "  --read_workers              OPTIONAL\n"
+              "                              DEFAULT: " << default_values::read_workers << "\n"
+              "                              Number of threads reading the camera streams in parallel. \n"
+              "                              0 reads the cameras one after another. \n"
+              "\n"
+              "  --blender_type              OPTIONAL\n"
+              "                              DEFAULT: " << default_values::blender_type << "\n"
+              "                              Blending method: 'feather', 'multiband', 'static_feather', 'static_multiband', \n"
+              "                              'stripes_feather' or 'stripes_multiband'. \n"
+              "                              The static blenders compute their weights once for a static rig \n"
+              "                              and output an 8-bit mosaic. The stripes blenders split the mosaic \n"
+              "                              in stripes blended in parallel. \n"
+              "\n"
+              "  --async_seams               OPTIONAL\n"
+              "                              DEFAULT: " << default_values::async_seams << "\n"
+              "                              With --do_update_seams, re-estimate the seams on a background thread \n"
+              "                              and swap them in once ready instead of stalling the stitched frame. \n"
+              "\n"
+              "  --exposure_cadence          OPTIONAL\n"
+              "                              DEFAULT: " << default_values::exposure_cadence << "\n"
+              "                              With --do_update_exposure, re-estimate the exposure on a background \n"
+              "                              thread every N frames. 0 re-estimates it inline at each frame. \n"
+              "\n"
+              "  --exposure_smoothing        OPTIONAL\n"
+              "                              DEFAULT: " << default_values::exposure_smoothing << "\n"
+              "                              Weight of the new gains on each exposure update, within ]0, 1]. \n"
+              "                              Lower values smooth the gains over time and avoid flicker. \n"
+              "\n"
+              "  --pipeline_depth            OPTIONAL\n"
+              "                              DEFAULT: " << default_values::pipeline_depth << "\n"
+              "                              Run capture, correction and blending as pipelined stages connected \n"
+              "                              by queues of N frames. 0 stitches one frame at a time. \n"
+              "\n"
+              "  --sink_type                 OPTIONAL\n"
+              "                              DEFAULT: " << default_values::sink_type << "\n"
+              "                              Output of the mosaics: 'png', 'jpeg' (one image per frame), 'video', \n"
+              "                              'raw' (uncompressed frames appended to a single file) or 'null'. \n"
+              "\n"
+              "  --sink_path                 OPTIONAL\n"
+              "                              DEFAULT: " << default_values::sink_path << "\n"
+              "                              Prefix of the image files, or path of the video and raw files \n"
+              "                              ('.avi' and '.raw' are appended when no extension is given). \n"
+              "\n"
+              "  --jpeg_quality              OPTIONAL\n"
+              "                              DEFAULT: " << default_values::jpeg_quality << "\n"
+              "                              JPEG quality from [0,100] range for the 'jpeg' sink. \n"
+              "\n"
+              "  --video_codec               OPTIONAL\n"
+              "                              DEFAULT: " << default_values::video_codec << "\n"
+              "                              FourCC code of the 'video' sink codec, ex. 'MJPG' or 'FFV1' (lossless). \n"
+              "\n"
+              "  --video_fps                 OPTIONAL\n"
+              "                              DEFAULT: " << default_values::video_fps << "\n"
+              "                              Frame rate of the 'video' sink. \n"
+              "\n"
+              "  --sink_queue                OPTIONAL\n"
+              "                              DEFAULT: " << default_values::sink_queue << "\n"
+              "                              Number of mosaics queued to the writer thread of the sink. \n"
+              "                              0 writes the mosaics on the stitching thread. \n"
+              "\n"
+              "  --shm_ring                  OPTIONAL\n"
+              "                              DEFAULT: none\n"
+              "                              Name of a POSIX shared memory ring, ex. '/laz_mosaic'. The mosaics are \n"
+              "                              published in its slots instead of the sink, for zero-copy readers \n"
+              "                              such as the shmreader app. \n"
+              "\n"
+              "  --shm_slots                 OPTIONAL\n"
+              "                              DEFAULT: " << default_values::shm_slots << "\n"
+              "                              Number of mosaic slots of the shared memory ring. \n"
+              "\n"
+              "  --frame_pool                OPTIONAL\n"
+              "                              DEFAULT: " << default_values::frame_pool << "\n"
+              "                              Recycle the image buffers of the previous frames instead of \n"
+              "                              allocating new ones for every frame. \n"
+              "\n"
+              "  --stats_interval            OPTIONAL\n"
+              "                              DEFAULT: " << default_values::stats_interval << "\n"
+              "                              Every N frames, dump the p50/p99/max timings of each stage and camera \n"
+              "                              as JSON to --stats_path. 0 disables the dumps. \n"
+              "\n"
+              "  --stats_path                OPTIONAL\n"
+              "                              DEFAULT: " << default_values::stats_path << "\n"
+              "                              Path of the JSON timing statistics, overwritten on every dump. \n"
+              "\n"
+              "  --map_cache                 OPTIONAL\n"
+              "                              DEFAULT: none\n"
+              "                              Directory caching the remap tables, masks and corners of the cameras. \n"
+              "                              Restarts with the same calibration load them instead of computing them. \n"
               "\n\n";
 }
 
@@ -68,6 +191,26 @@ int main(int argc, char** argv) {
     bool do_update_seams = default_values::do_update_seams;
     float scale_factor = default_values::scale_factor;
     float blend_strength = default_values::blend_strength;
+    bool compact_maps = default_values::compact_maps;
+    int prefetch_depth = default_values::prefetch_depth;
+    int read_workers = default_values::read_workers;
+    std::string blender_type = default_values::blender_type;
+    bool async_seams = default_values::async_seams;
+    int exposure_cadence = default_values::exposure_cadence;
+    float exposure_smoothing = default_values::exposure_smoothing;
+    int pipeline_depth = default_values::pipeline_depth;
+    std::string sink_type = default_values::sink_type;
+    std::string sink_path = default_values::sink_path;
+    int jpeg_quality = default_values::jpeg_quality;
+    std::string video_codec = default_values::video_codec;
+    double video_fps = default_values::video_fps;
+    int sink_queue = default_values::sink_queue;
+    std::string shm_ring = default_values::shm_ring;
+    int shm_slots = default_values::shm_slots;
+    bool frame_pool = default_values::frame_pool;
+    int stats_interval = default_values::stats_interval;
+    std::string stats_path = default_values::stats_path;
+    std::string map_cache = default_values::map_cache;
 
     // Unarg Parameters
     float gamma_corr_alpha = 1.8f;
@@ -114,6 +257,83 @@ int main(int argc, char** argv) {
             i++;
             scale_factor = std::atof(argv[i]);
         }
+        else if (std::string(argv[i]) == "--compact_maps"){
+            compact_maps = true;
+        }
+        else if (std::string(argv[i]) == "--prefetch_depth"){
+            i++;
+            prefetch_depth = std::atoi(argv[i]);
+        }
+        else if (std::string(argv[i]) == "--read_workers"){
+            i++;
+            read_workers = std::atoi(argv[i]);
+        }
+        else if (std::string(argv[i]) == "--blender_type"){
+            i++;
+            blender_type = std::string(argv[i]);
+        }
+        else if (std::string(argv[i]) == "--async_seams"){
+            async_seams = true;
+        }
+        else if (std::string(argv[i]) == "--exposure_cadence"){
+            i++;
+            exposure_cadence = std::atoi(argv[i]);
+        }
+        else if (std::string(argv[i]) == "--exposure_smoothing"){
+            i++;
+            exposure_smoothing = std::atof(argv[i]);
+        }
+        else if (std::string(argv[i]) == "--pipeline_depth"){
+            i++;
+            pipeline_depth = std::atoi(argv[i]);
+        }
+        else if (std::string(argv[i]) == "--sink_type"){
+            i++;
+            sink_type = std::string(argv[i]);
+        }
+        else if (std::string(argv[i]) == "--sink_path"){
+            i++;
+            sink_path = std::string(argv[i]);
+        }
+        else if (std::string(argv[i]) == "--jpeg_quality"){
+            i++;
+            jpeg_quality = std::atoi(argv[i]);
+        }
+        else if (std::string(argv[i]) == "--video_codec"){
+            i++;
+            video_codec = std::string(argv[i]);
+        }
+        else if (std::string(argv[i]) == "--video_fps"){
+            i++;
+            video_fps = std::atof(argv[i]);
+        }
+        else if (std::string(argv[i]) == "--sink_queue"){
+            i++;
+            sink_queue = std::atoi(argv[i]);
+        }
+        else if (std::string(argv[i]) == "--shm_ring"){
+            i++;
+            shm_ring = std::string(argv[i]);
+        }
+        else if (std::string(argv[i]) == "--shm_slots"){
+            i++;
+            shm_slots = std::atoi(argv[i]);
+        }
+        else if (std::string(argv[i]) == "--frame_pool"){
+            frame_pool = true;
+        }
+        else if (std::string(argv[i]) == "--stats_interval"){
+            i++;
+            stats_interval = std::atoi(argv[i]);
+        }
+        else if (std::string(argv[i]) == "--stats_path"){
+            i++;
+            stats_path = std::string(argv[i]);
+        }
+        else if (std::string(argv[i]) == "--map_cache"){
+            i++;
+            map_cache = std::string(argv[i]);
+        }
         else
         {
             std::string error_msg = "Unknown parameter '" + std::string(argv[i]) + "'.";
@@ -128,40 +348,122 @@ int main(int argc, char** argv) {
         throw std::runtime_error(error_msg);
     }
 
+    // Never released: Mats allocated from the pool, including OpenCV internal ones, may outlive main()
+    laz::FramePoolAllocator* frame_pool_allocator = nullptr;
+    if (frame_pool)
+    {
+        frame_pool_allocator = new laz::FramePoolAllocator();
+        cv::Mat::setDefaultAllocator(frame_pool_allocator);
+    }
+
     const std::vector<std::tuple<laz::CvCylindricalCamera*,std::vector<std::string>>>& cameras_data =
-            laz::load_fakestream<laz::CvCylindricalCamera>(calibration_path.string(), dataset_path.string());
+            map_cache.empty() ?
+            laz::load_fakestream<laz::CvCylindricalCamera>(calibration_path.string(), dataset_path.string()) :
+            laz::load_fakestream<laz::CvCylindricalCamera>(calibration_path.string(), dataset_path.string(), map_cache);
 
     std::vector<laz::CameraStream*> streams;
     for(int i=0;i<cameras_data.size();i++)
     {
         laz::CvCylindricalCamera* cam_ptr = std::get<0>(cameras_data[i]);
         const std::vector<std::string>& img_paths = std::get<1>(cameras_data[i]);
-        streams.push_back(new laz::CameraFakeStream(cam_ptr, img_paths));
+        if (compact_maps)
+            cam_ptr->set_map_mode(laz::MapMode::COMPACT_MAPS);
+        streams.push_back(new laz::CameraFakeStream(cam_ptr, img_paths, prefetch_depth));
     }
 
     // Components declaration
-    auto* stream_bundle = new laz::StreamBundler(streams);
+    auto* stream_bundle = new laz::StreamBundler(streams, read_workers);
     stream_bundle->connect();
     auto* gamma_corrector = new laz::GammaCorrector(gamma_corr_alpha, gamma_corr_beta);
     auto* exposure_compensator = new laz::CvExposureCompensatorChannelsBlocks();
+    exposure_compensator->set_smoothing(exposure_smoothing);
     auto* seam_finder = new laz::CvSeamFinderGcColorGrad (scale_factor);
-    auto* blender = new laz::CvBlenderFeather(blend_strength);
+    laz::Blender* blender = nullptr;
+    if (blender_type == "feather")
+        blender = new laz::CvBlenderFeather(blend_strength);
+    else if (blender_type == "multiband")
+        blender = new laz::CvBlenderMultiBand(blend_strength);
+    else if (blender_type == "static_feather")
+        blender = new laz::BlenderStaticFeather(blend_strength);
+    else if (blender_type == "static_multiband")
+        blender = new laz::BlenderStaticMultiBand(blend_strength);
+    else if (blender_type == "stripes_feather")
+        blender = new laz::CvBlenderStripes(cv::detail::Blender::FEATHER, 0, blend_strength);
+    else if (blender_type == "stripes_multiband")
+        blender = new laz::CvBlenderStripes(cv::detail::Blender::MULTI_BAND, 0, blend_strength);
+    else
+        throw std::runtime_error("Error: Unknown blender type '" + blender_type + "'.");
+
+    std::unique_ptr<laz::OutputSink> sink;
+    if (sink_type == "png")
+        sink.reset(new laz::PngSink(sink_path));
+    else if (sink_type == "jpeg")
+        sink.reset(new laz::JpegSink(sink_path, jpeg_quality));
+    else if (sink_type == "video")
+        sink.reset(new laz::VideoSink(fs::path(sink_path).has_extension() ? sink_path : sink_path + ".avi",
+                                      video_codec, video_fps));
+    else if (sink_type == "raw")
+        sink.reset(new laz::RawSink(fs::path(sink_path).has_extension() ? sink_path : sink_path + ".raw"));
+    else if (sink_type == "null")
+        sink.reset(new laz::NullSink());
+    else
+        throw std::runtime_error("Error: Unknown sink type '" + sink_type + "'.");
+    if (sink_queue > 0)
+        sink.reset(new laz::AsyncSink(std::move(sink), sink_queue));
 
     // Stitcher build
-    auto stitcher = laz::Stitcher::StitcherBuilder(stream_bundle, blender)
-            .attach_gamma_corrector(gamma_corrector)
-            .attach_exp_compensator(exposure_compensator)
-            .attach_seam_finder(seam_finder)
-            .build();
-    stitcher.init_from_current_stream();
-
-    cv::Mat mosaic;
-    int img_idx=0;
-    while (stitcher.read(mosaic, do_update_exposure, do_update_seams)){
-        img_idx++;
-        cv::imwrite("mosaic_" + std::to_string(img_idx)+".png", mosaic);
+    {
+        auto builder = laz::Stitcher::StitcherBuilder(stream_bundle, blender)
+                .attach_gamma_corrector(gamma_corrector)
+                .attach_exp_compensator(exposure_compensator)
+                .attach_seam_finder(seam_finder);
+        if (async_seams)
+            builder.enable_async_seam_update();
+        if (exposure_cadence > 0)
+            builder.enable_async_exposure_update(exposure_cadence);
+        if (pipeline_depth > 0)
+            builder.enable_pipeline(pipeline_depth);
+        // Scoped: the stitcher must be released before its components
+        auto stitcher = builder.build();
+        stitcher.init_from_current_stream();
+
+        std::unique_ptr<laz::ShmRingWriter> ring;
+        if (!shm_ring.empty())
+            ring = std::make_unique<laz::ShmRingWriter>(shm_ring, shm_slots,
+                                                        stitcher.get_mosaic_size().area() * CV_ELEM_SIZE(blender->output_type()));
+
+        const auto dump_stats = [&](const long& _nr_frames) {
+            nlohmann::json stats = stitcher.get_timing_stats().to_json();
+            stats["frames"] = _nr_frames;
+            std::ofstream(stats_path) << stats.dump(2);
+            for (const auto& stage : stitcher.get_stage_stats())
+                PLOGD << "Stage '" << stage.name << "': " << stage.queue_depth << " queued frames, last frame in "
+                      << stage.latency_ms << " ms.";
+        };
+
+        cv::Mat mosaic;
+        long nr_frames = 0;
+        while (ring ? stitcher.read(*ring, do_update_exposure, do_update_seams)
+                    : stitcher.read(mosaic, do_update_exposure, do_update_seams)) {
+            nr_frames++;
+            if (!ring)
+            {
+                const auto start = std::chrono::steady_clock::now();
+                sink->write(mosaic);
+                const std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+                stitcher.record_timing(laz::Stitcher::Timing::OUTPUT, elapsed.count());
+            }
+            if (stats_interval > 0 && nr_frames % stats_interval == 0)
+                dump_stats(nr_frames);
+        }
+        if (stats_interval > 0)
+            dump_stats(nr_frames);
     }
+    sink->close();
     PLOGI << "Stitching Done.";
+    if (frame_pool_allocator)
+        PLOGI << "Frame pool: " << frame_pool_allocator->get_nr_allocations() << " buffers allocated, "
+              << frame_pool_allocator->get_nr_reuses() << " reused.";
 
     delete stream_bundle; stream_bundle = nullptr;
     delete gamma_corrector; gamma_corrector = nullptr;
@@ -0,0 +1,106 @@
+#include <cmath>
+#include <string>
+#include <vector>
+#include <fstream>
+
+#include <benchmark/benchmark.h>
+#include <opencv2/core.hpp>
+#include <opencv2/calib3d.hpp>
+
+#include "dataloader/dataloader.h"
+#include "calibration/calibrator.h"
+#include "paths.h"
+
+namespace BenchConfig{
+    static const std::string intrinsic_calib_path = getAssetsDirPath() + "/test_intrinsic_calib.json";
+    static const std::string extrinsic_calib_path = getAssetsDirPath() + "/test_extrinsic_calib.json";
+    static const std::string dataset_path = getAssetsDirPath() + "/test_dataset.json";
+    static const float features_conf_thresh = 0.65;
+}
+
+static cv::Mat to_double(const cv::Mat& _mat)
+{
+    cv::Mat mat;
+    _mat.convertTo(mat, CV_64F);
+    return mat;
+}
+
+/**
+ * Angle, in degrees, between two rotations.
+ */
+static double get_angle(const cv::Mat& _R1, const cv::Mat& _R2)
+{
+    cv::Mat rvec;
+    cv::Rodrigues(cv::Mat(to_double(_R1).t() * to_double(_R2)), rvec);
+    return cv::norm(rvec) * 180. / CV_PI;
+}
+
+/**
+ * Error of a calibration against the reference extrinsic calibration of the test assets: mean rotation error of
+ * each image relative to the first one, since the global orientation is arbitrary, and mean relative focal error.
+ */
+static void set_accuracy_counters(benchmark::State& state, const std::vector<laz::RotationCamera>& _cams)
+{
+    std::ifstream reference_file(BenchConfig::extrinsic_calib_path);
+    const nlohmann::json reference_json = nlohmann::json::parse(reference_file);
+    auto get_reference = [&reference_json](const std::string& _name) {
+        return laz::parameters_from_json(_name, reference_json["cameras"][_name]);
+    };
+
+    const laz::CameraParameters reference_origin = get_reference(_cams.front().get_name());
+    double rotation_error = 0., focal_error = 0.;
+    for (const auto& cam : _cams)
+    {
+        const laz::CameraParameters reference = get_reference(cam.get_name());
+        const cv::Mat relative_R = to_double(_cams.front().get_rotation()).t() * to_double(cam.get_rotation());
+        const cv::Mat reference_relative_R = to_double(reference_origin.rotation).t() * to_double(reference.rotation);
+        rotation_error += get_angle(relative_R, reference_relative_R);
+
+        const double focal = to_double(cam.get_extrinsic()).at<double>(0, 0);
+        const double reference_focal = to_double(reference.extrinsic).at<double>(0, 0);
+        focal_error += std::abs(focal / reference_focal - 1.);
+    }
+    state.counters["rot_err_deg"] = rotation_error / _cams.size();
+    state.counters["focal_err_pct"] = 100. * focal_error / _cams.size();
+    state.counters["images"] = _cams.size();
+}
+
+/**
+ * Extrinsic calibration of the test assets at a work resolution of {work_kpix} kilopixels (full resolution if 0),
+ * optionally refined at full resolution.
+ */
+static void BM_Calibrate(benchmark::State& state)
+{
+    std::vector<laz::CameraCalibration*> calib_cams = laz::load_calibration_cams(BenchConfig::intrinsic_calib_path,
+                                                                                BenchConfig::dataset_path);
+    const double work_megapix = state.range(0) > 0 ? state.range(0) / 1000. : -1.;
+    laz::Calibrator calibrator(BenchConfig::features_conf_thresh, laz::BundleAdjustor::RAY,
+                               work_megapix, state.range(1) != 0);
+
+    std::vector<laz::RotationCamera> calibrated_cams;
+    for (auto _ : state)
+    {
+        calibrated_cams = calibrator.calibrate(calib_cams);
+        if (calibrated_cams.empty())
+        {
+            state.SkipWithError("Calibration failed");
+            break;
+        }
+    }
+    if (!calibrated_cams.empty())
+        set_accuracy_counters(state, calibrated_cams);
+
+    for (auto cam : calib_cams)
+        delete cam;
+}
+BENCHMARK(BM_Calibrate)
+        ->ArgNames({"work_kpix", "refine"})
+        ->Args({0, 0})
+        ->Args({1000, 0})
+        ->Args({600, 0})
+        ->Args({300, 0})
+        ->Args({600, 1})
+        ->Args({300, 1})
+        ->Unit(benchmark::kSecond);
+
+BENCHMARK_MAIN();
@@ -0,0 +1,44 @@
+#include <benchmark/benchmark.h>
+#include <opencv2/core.hpp>
+
+#include "core/camera.h"
+#include "core/cvcamera.h"
+
+namespace BenchConfig{
+    static const float focal_ratio = 0.73f;
+    static const float radius_ratio = 0.65f;
+}
+
+laz::RotationCamera make_rotation_camera(const cv::Size& _dims)
+{
+    const float focal = BenchConfig::focal_ratio * _dims.width;
+    cv::Mat intrinsic = (cv::Mat_<float>(3, 3) << focal, 0.f, _dims.width/2.f,
+                                                   0.f, focal, _dims.height/2.f,
+                                                   0.f, 0.f, 1.f);
+    cv::Mat dist_coeffs = (cv::Mat_<float>(1, 5) << -0.09f, 0.07f, 0.f, 0.f, 0.f);
+    laz::IntrinsicCamera intrinsic_cam(laz::Camera("bench", _dims), intrinsic, dist_coeffs);
+    laz::ExtrinsicCamera extrinsic_cam(intrinsic_cam, intrinsic);
+    return laz::RotationCamera(extrinsic_cam, cv::Mat::eye(3, 3, CV_32FC1), BenchConfig::radius_ratio * _dims.width);
+}
+
+template <typename T>
+static void BM_CameraInit(benchmark::State& state)
+{
+    const laz::RotationCamera rot_cam = make_rotation_camera(cv::Size(state.range(0), state.range(1)));
+    for (auto _ : state)
+    {
+        T cam(rot_cam);
+        cam.build_maps();
+        benchmark::DoNotOptimize(cam);
+    }
+}
+BENCHMARK_TEMPLATE(BM_CameraInit, laz::CylindricalCamera)
+        ->Args({1920, 1080})
+        ->Args({3840, 2160})
+        ->Unit(benchmark::kMillisecond);
+BENCHMARK_TEMPLATE(BM_CameraInit, laz::CvCylindricalCamera)
+        ->Args({1920, 1080})
+        ->Args({3840, 2160})
+        ->Unit(benchmark::kMillisecond);
+
+BENCHMARK_MAIN();
@@ -0,0 +1,54 @@
+#include <benchmark/benchmark.h>
+#include <opencv2/core.hpp>
+#include <opencv2/imgproc.hpp>
+
+#include "core/camera.h"
+
+namespace BenchConfig{
+    static const cv::Size dims(3840, 2160);
+    static const float focal = 2800.f;
+}
+
+laz::IntrinsicCamera make_camera()
+{
+    cv::Mat intrinsic = (cv::Mat_<float>(3, 3) << BenchConfig::focal, 0.f, BenchConfig::dims.width/2.f,
+                                                   0.f, BenchConfig::focal, BenchConfig::dims.height/2.f,
+                                                   0.f, 0.f, 1.f);
+    cv::Mat dist_coeffs = (cv::Mat_<float>(1, 5) << -0.09f, 0.07f, 0.f, 0.f, 0.f);
+    return laz::IntrinsicCamera(laz::Camera("bench", BenchConfig::dims), intrinsic, dist_coeffs);
+}
+
+cv::Mat make_image()
+{
+    // Smoothed noise: keeps the interpolation error representative of natural images
+    cv::Mat img(BenchConfig::dims, CV_8UC3);
+    cv::randu(img, cv::Scalar::all(0), cv::Scalar::all(255));
+    cv::GaussianBlur(img, img, cv::Size(7, 7), 0);
+    return img;
+}
+
+static void BM_CameraRemap(benchmark::State& state)
+{
+    const laz::MapMode mode = static_cast<laz::MapMode>(state.range(0));
+    const laz::IntrinsicCamera reference_cam = make_camera();
+    laz::IntrinsicCamera cam = reference_cam;
+    cam.set_map_mode(mode);
+    const cv::Mat img = make_image();
+
+    cv::Mat remapped;
+    for (auto _ : state)
+        cam.remap(img, remapped, cv::INTER_LINEAR, cv::BORDER_REFLECT);
+
+    // Max pixel error against the float maps
+    cv::Mat reference;
+    reference_cam.remap(img, reference, cv::INTER_LINEAR, cv::BORDER_REFLECT);
+    state.counters["max_pixel_error"] = cv::norm(remapped, reference, cv::NORM_INF);
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations()) * img.total() * img.elemSize());
+    state.SetLabel(mode == laz::MapMode::COMPACT_MAPS ? "compact" : "float");
+}
+BENCHMARK(BM_CameraRemap)
+        ->Arg(laz::MapMode::FLOAT_MAPS)
+        ->Arg(laz::MapMode::COMPACT_MAPS)
+        ->Unit(benchmark::kMillisecond);
+
+BENCHMARK_MAIN();
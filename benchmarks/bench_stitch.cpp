@@ -0,0 +1,229 @@
+#include <benchmark/benchmark.h>
+#include <opencv2/core.hpp>
+
+#include "benchrig.h"
+#include "stitching/gammacorrector.h"
+#include "stitching/histogramequal.h"
+#include "stitching/exposurecompensator.h"
+#include "stitching/seamfinder.h"
+#include "stitching/blender.h"
+#include "stitching/stitcher.h"
+
+namespace BenchConfig{
+    static const float gamma_alpha = 1.2f;
+    static const uint8_t gamma_beta = 10;
+    static const float seam_downscale = 0.5f;
+    static const float blend_strength = 5.f;
+}
+
+/**
+ * Restore the input bundle of an in-place operation, outside of the timed region.
+ */
+static void restore_bundle(benchmark::State& state, const std::vector<cv::Mat>& _src, std::vector<cv::Mat>& _dst)
+{
+    state.PauseTiming();
+    _dst.resize(_src.size());
+    for (int i = 0; i < _src.size(); i++)
+        _src[i].copyTo(_dst[i]);
+    state.ResumeTiming();
+}
+
+static void set_bundle_throughput(benchmark::State& state, const SyntheticRig& _rig)
+{
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations()));
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations()) * _rig.get_bundle_bytes());
+}
+
+static void BM_CameraRemap(benchmark::State& state)
+{
+    const SyntheticRig& rig = get_rig(state);
+    const laz::CvCylindricalCamera& cam = rig.get_camera(0);
+    const cv::Mat& src = rig.get_stream(0).get_source();
+
+    cv::Mat remapped;
+    for (auto _ : state)
+        cam.remap(src, remapped);
+
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations()));
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations()) * src.total() * src.elemSize());
+}
+BENCHMARK(BM_CameraRemap)->Apply(RigArguments)->Unit(benchmark::kMillisecond);
+
+static void BM_GammaCorrector(benchmark::State& state)
+{
+    const SyntheticRig& rig = get_rig(state);
+    const std::vector<cv::Mat>& mask_bundle = rig.get_geometry()->get_mask_bundle();
+    laz::GammaCorrector gamma_corrector(BenchConfig::gamma_alpha, BenchConfig::gamma_beta);
+
+    std::vector<cv::Mat> img_bundle;
+    for (auto _ : state)
+    {
+        restore_bundle(state, rig.get_img_bundle(), img_bundle);
+        gamma_corrector.apply(img_bundle, mask_bundle);
+    }
+    set_bundle_throughput(state, rig);
+}
+BENCHMARK(BM_GammaCorrector)->Apply(RigArguments)->Unit(benchmark::kMillisecond);
+
+template <laz::EqualizationMode Mode>
+static void BM_HistogramEqualizer(benchmark::State& state)
+{
+    const SyntheticRig& rig = get_rig(state);
+    const std::vector<cv::Mat>& mask_bundle = rig.get_geometry()->get_mask_bundle();
+    laz::HistogramEqualizer equalizer(Mode);
+
+    std::vector<cv::Mat> img_bundle;
+    for (auto _ : state)
+    {
+        restore_bundle(state, rig.get_img_bundle(), img_bundle);
+        equalizer.apply(img_bundle, mask_bundle);
+    }
+    set_bundle_throughput(state, rig);
+}
+BENCHMARK_TEMPLATE(BM_HistogramEqualizer, laz::EqualizationMode::LAB)->Apply(RigArguments)->Unit(benchmark::kMillisecond);
+BENCHMARK_TEMPLATE(BM_HistogramEqualizer, laz::EqualizationMode::LUMA)->Apply(RigArguments)->Unit(benchmark::kMillisecond);
+
+/**
+ * Gain estimation, as run by init() and by each exposure update.
+ */
+template <class TCompensator>
+static void BM_ExposureEstimate(benchmark::State& state)
+{
+    const SyntheticRig& rig = get_rig(state);
+    TCompensator compensator;
+
+    for (auto _ : state)
+        compensator.init(rig.get_img_bundle(), rig.get_geometry());
+
+    set_bundle_throughput(state, rig);
+}
+BENCHMARK_TEMPLATE(BM_ExposureEstimate, laz::CvExposureCompensatorGain)->Apply(RigArguments)->Unit(benchmark::kMillisecond);
+BENCHMARK_TEMPLATE(BM_ExposureEstimate, laz::CvExposureCompensatorChannels)->Apply(RigArguments)->Unit(benchmark::kMillisecond);
+BENCHMARK_TEMPLATE(BM_ExposureEstimate, laz::CvExposureCompensatorGainBlocks)->Apply(RigArguments)->Unit(benchmark::kMillisecond);
+BENCHMARK_TEMPLATE(BM_ExposureEstimate, laz::CvExposureCompensatorChannelsBlocks)->Apply(RigArguments)->Unit(benchmark::kMillisecond);
+
+/**
+ * Per-frame gain application.
+ */
+template <class TCompensator>
+static void BM_ExposureApply(benchmark::State& state)
+{
+    const SyntheticRig& rig = get_rig(state);
+    TCompensator compensator;
+    compensator.init(rig.get_img_bundle(), rig.get_geometry());
+
+    std::vector<cv::Mat> img_bundle;
+    for (auto _ : state)
+    {
+        restore_bundle(state, rig.get_img_bundle(), img_bundle);
+        compensator.apply(img_bundle);
+    }
+    set_bundle_throughput(state, rig);
+}
+BENCHMARK_TEMPLATE(BM_ExposureApply, laz::CvExposureCompensatorGain)->Apply(RigArguments)->Unit(benchmark::kMillisecond);
+BENCHMARK_TEMPLATE(BM_ExposureApply, laz::CvExposureCompensatorChannels)->Apply(RigArguments)->Unit(benchmark::kMillisecond);
+BENCHMARK_TEMPLATE(BM_ExposureApply, laz::CvExposureCompensatorGainBlocks)->Apply(RigArguments)->Unit(benchmark::kMillisecond);
+BENCHMARK_TEMPLATE(BM_ExposureApply, laz::CvExposureCompensatorChannelsBlocks)->Apply(RigArguments)->Unit(benchmark::kMillisecond);
+
+template <class TSeamFinder>
+static void BM_SeamFind(benchmark::State& state)
+{
+    const SyntheticRig& rig = get_rig(state);
+    TSeamFinder seam_finder(BenchConfig::seam_downscale);
+
+    for (auto _ : state)
+        seam_finder.init(rig.get_img_bundle(), rig.get_geometry());
+
+    set_bundle_throughput(state, rig);
+}
+BENCHMARK_TEMPLATE(BM_SeamFind, laz::CvSeamFinderVoronoi)->Apply(RigArguments)->Unit(benchmark::kMillisecond);
+BENCHMARK_TEMPLATE(BM_SeamFind, laz::CvSeamFinderGcColor)->Apply(RigArguments)->Unit(benchmark::kMillisecond);
+BENCHMARK_TEMPLATE(BM_SeamFind, laz::CvSeamFinderGcColorGrad)->Apply(RigArguments)->Unit(benchmark::kMillisecond);
+BENCHMARK_TEMPLATE(BM_SeamFind, laz::CvSeamFinderDpColor)->Apply(RigArguments)->Unit(benchmark::kMillisecond);
+BENCHMARK_TEMPLATE(BM_SeamFind, laz::CvSeamFinderDpColorGrad)->Apply(RigArguments)->Unit(benchmark::kMillisecond);
+
+template <class TBlender>
+static void BM_Blend(benchmark::State& state)
+{
+    const SyntheticRig& rig = get_rig(state);
+    TBlender blender(BenchConfig::blend_strength);
+    blender.init(rig.get_geometry());
+
+    cv::Mat mosaic;
+    for (auto _ : state)
+        blender.blend(rig.get_img_bundle(), mosaic);
+
+    set_bundle_throughput(state, rig);
+}
+BENCHMARK_TEMPLATE(BM_Blend, laz::CvBlenderFeather)->Apply(RigArguments)->Unit(benchmark::kMillisecond);
+BENCHMARK_TEMPLATE(BM_Blend, laz::BlenderStaticFeather)->Apply(RigArguments)->Unit(benchmark::kMillisecond);
+BENCHMARK_TEMPLATE(BM_Blend, laz::CvBlenderMultiBand)->Apply(RigArguments)->Unit(benchmark::kMillisecond);
+BENCHMARK_TEMPLATE(BM_Blend, laz::BlenderStaticMultiBand)->Apply(RigArguments)->Unit(benchmark::kMillisecond);
+
+static void BM_BlendStripes(benchmark::State& state)
+{
+    const SyntheticRig& rig = get_rig(state);
+    laz::CvBlenderStripes blender(state.range(4), state.range(5), BenchConfig::blend_strength);
+    blender.init(rig.get_geometry());
+
+    cv::Mat mosaic;
+    for (auto _ : state)
+        blender.blend(rig.get_img_bundle(), mosaic);
+
+    set_bundle_throughput(state, rig);
+    state.SetLabel(state.range(4) == cv::detail::Blender::FEATHER ? "feather" : "multiband");
+}
+
+/**
+ * Rigs of RigArguments, each blended by feather and multi-band stripes.
+ */
+static void StripesArguments(benchmark::internal::Benchmark* b)
+{
+    std::vector<std::string> arg_names = BenchRig::arg_names;
+    arg_names.insert(arg_names.end(), {"type", "stripes"});
+    b->ArgNames(arg_names);
+    for (const auto& rig_args : BenchRig::args)
+        for (const int& type : {cv::detail::Blender::FEATHER, cv::detail::Blender::MULTI_BAND})
+            for (const int& nr_stripes : {1, 4, 16})
+            {
+                std::vector<int64_t> args = rig_args;
+                args.insert(args.end(), {type, nr_stripes});
+                b->Args(args);
+            }
+}
+BENCHMARK(BM_BlendStripes)->Apply(StripesArguments)->Unit(benchmark::kMillisecond);
+
+/**
+ * Full stitching of a frame with the components of the stitch app: bundle read and remap, gamma, exposure
+ * compensation and blending. Exposure and seams are estimated once, at init.
+ */
+static void BM_StitcherRead(benchmark::State& state)
+{
+    const SyntheticRig& rig = get_rig(state);
+    laz::GammaCorrector gamma_corrector(BenchConfig::gamma_alpha, BenchConfig::gamma_beta);
+    laz::CvExposureCompensatorChannelsBlocks exposure_compensator;
+    laz::CvSeamFinderGcColorGrad seam_finder(BenchConfig::seam_downscale);
+    laz::CvBlenderFeather blender(BenchConfig::blend_strength);
+
+    auto stitcher = laz::Stitcher::StitcherBuilder(rig.get_bundler(), &blender)
+            .attach_gamma_corrector(&gamma_corrector)
+            .attach_exp_compensator(&exposure_compensator)
+            .attach_seam_finder(&seam_finder)
+            .build();
+    stitcher.init_from_current_stream();
+
+    cv::Mat mosaic;
+    for (auto _ : state)
+        if (!stitcher.read(mosaic))
+        {
+            state.SkipWithError("Stitcher failed to read the rig");
+            break;
+        }
+
+    set_bundle_throughput(state, rig);
+    state.counters["mosaic_width"] = mosaic.cols;
+    state.counters["mosaic_height"] = mosaic.rows;
+}
+BENCHMARK(BM_StitcherRead)->Apply(RigArguments)->Unit(benchmark::kMillisecond);
+
+BENCHMARK_MAIN();
@@ -0,0 +1,47 @@
+#ifndef LIVESTITCHER_BENCHRIG_H
+#define LIVESTITCHER_BENCHRIG_H
+#include <map>
+#include <tuple>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+#include "syntheticrig.h"
+
+namespace BenchRig{
+    // Rigs covered by the stitching benchmarks: number of cameras, resolution and overlap
+    static const std::vector<std::string> arg_names = {"cams", "width", "height", "overlap"};
+    static const std::vector<std::vector<int64_t>> args = {{2, 1280, 720, 30},
+                                                           {4, 1920, 1080, 15},
+                                                           {4, 1920, 1080, 30},
+                                                           {6, 1920, 1080, 30}};
+}
+
+/**
+ * Rig described by the benchmark arguments {nr_cams, width, height, overlap_percent}. Rigs are built once and
+ * shared by all the benchmarks of the executable, since benchmark functions are run several times per argument set.
+ */
+inline const SyntheticRig& get_rig(const benchmark::State& state)
+{
+    static std::map<std::tuple<int64_t, int64_t, int64_t, int64_t>, std::unique_ptr<SyntheticRig>> rigs;
+    const auto key = std::make_tuple(state.range(0), state.range(1), state.range(2), state.range(3));
+    auto& rig = rigs[key];
+    if (!rig)
+        rig = std::make_unique<SyntheticRig>(state.range(0), cv::Size(state.range(1), state.range(2)),
+                                             state.range(3) / 100.f);
+    return *rig;
+}
+
+/**
+ * Rigs covered by the stitching benchmarks, see BenchRig::args.
+ */
+inline void RigArguments(benchmark::internal::Benchmark* b)
+{
+    b->ArgNames(BenchRig::arg_names);
+    for (const auto& rig_args : BenchRig::args)
+        b->Args(rig_args);
+}
+
+#endif //LIVESTITCHER_BENCHRIG_H
@@ -0,0 +1,29 @@
+#!/bin/sh
+
+# Note: It is best to install libraries in /prefix to make the use of docker multistage easier.
+apt-get update
+apt-get install -y --no-install-recommends g++ git
+
+git clone --depth 1 --branch v1.5.2 https://github.com/google/benchmark
+cd benchmark
+mkdir build && cd build
+
+/prefix/bin/cmake \
+  -D CMAKE_BUILD_TYPE=RELEASE \
+  -D CMAKE_INSTALL_PREFIX=/prefix/ \
+  -D BENCHMARK_ENABLE_TESTING=OFF \
+  -D BENCHMARK_ENABLE_GTEST_TESTS=OFF \
+  ..
+
+make -j$(nproc)
+make install -j$(nproc)
+cd .. && mkdir ../licenses/benchmark && cp LICENSE ../licenses/benchmark/
+cd .. && rm -rf benchmark
+
+BENCHMARK_FILE="/prefix/lib/libbenchmark.a"
+if [ ! -f $BENCHMARK_FILE ]; then
+    echo "BENCHMARK was not correctly installed."
+    exit 1
+fi
+
+exit 0
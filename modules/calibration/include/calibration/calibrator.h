@@ -1,6 +1,7 @@
 #ifndef LIVESTITCHER_CALIBRATOR_H
 #define LIVESTITCHER_CALIBRATOR_H
 #include <vector>
+#include <memory>
 #include <string>
 #include <assert.h>
 #include <unordered_map>
@@ -27,18 +28,51 @@ namespace laz {
 
     class Calibrator {
     public:
+        /**
+         * @param _work_megapix : Resolution of feature detection, matching and bundle adjustment, in megapixels.
+         *                        Images are processed at full resolution if <= 0. The calibration is rescaled
+         *                        to full resolution.
+         * @param _refine_full_res : Detect features again at full resolution around the work scale inliers, match
+         *                           them within the windows of the work scale matches, and adjust the rescaled
+         *                           calibration on these full resolution matches
+         */
         Calibrator(const float &_features_conf_thresh=0.65,
-                   const BundleAdjustor &_bundle_adjustor=BundleAdjustor::RAY):
+                   const BundleAdjustor &_bundle_adjustor=BundleAdjustor::RAY,
+                   const double &_work_megapix=-1,
+                   const bool &_refine_full_res=false):
                    m_features_conf_thresh(_features_conf_thresh),
                    m_conf_thresh(0.95),
-                   m_bundle_adjustor(_bundle_adjustor)
+                   m_bundle_adjustor(_bundle_adjustor),
+                   m_work_megapix(_work_megapix),
+                   m_refine_full_res(_refine_full_res)
                    {};
 
-        const std::vector<RotationCamera> calibrate(const std::vector<CameraCalibration*>& _cameras);
+        /**
+         * @param _cameras : Calibration images, their features are extracted in parallel
+         * @param _match_mask : Optional CV_8UC1 mask of _cameras.size() squared. Only the image pairs with a
+         *                      non-zero entry are matched, all the pairs are matched if empty.
+         */
+        const std::vector<RotationCamera> calibrate(const std::vector<CameraCalibration*>& _cameras,
+                                                    const cv::Mat& _match_mask=cv::Mat());
 
     protected:
+        double get_work_scale(const cv::Size& _dims) const;
+
+        /**
+         * Full resolution features and matches of the work scale ones, see _refine_full_res.
+         * @param _features, _pairwise_matches : Work scale features and matches of the images kept for calibration
+         * @return false if an image is left without any confident pair at full resolution
+         */
+        bool refine_matches(const std::vector<CameraCalibration*>& _cameras, const std::vector<double>& _work_scales,
+                            const std::vector<cv::detail::ImageFeatures>& _features,
+                            const std::vector<cv::detail::MatchesInfo>& _pairwise_matches,
+                            std::vector<cv::detail::ImageFeatures>& _full_features,
+                            std::vector<cv::detail::MatchesInfo>& _full_matches) const;
+
         const float m_features_conf_thresh, m_conf_thresh;
         const BundleAdjustor m_bundle_adjustor;
+        const double m_work_megapix;
+        const bool m_refine_full_res;
     };
 } // namespace laz
 
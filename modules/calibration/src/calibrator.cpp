@@ -1,5 +1,10 @@
 #include "calibration/calibrator.h"
 #include "core/camera.h"
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <set>
+#include "opencv2/calib3d.hpp"
 
 #ifdef HAVE_OPENCV_XFEATURES2D
 #include "opencv2/features2d.hpp"
@@ -20,31 +25,237 @@ namespace laz {
             return T( (items[items.size() / 2 - 1] + items[items.size() / 2]) / 2);
     }
 
-    const std::vector<RotationCamera> Calibrator::calibrate(const std::vector<CameraCalibration*>& _cameras) {
-        assert(!_cameras.empty());
-
+    static cv::Ptr<cv::Feature2D> create_finder()
+    {
     #ifdef HAVE_OPENCV_XFEATURES2D
         int minHessian = 400;
-        auto finder = cv::xfeatures2d::SURF::create(minHessian);
+        return cv::xfeatures2d::SURF::create(minHessian);
     #else
-        auto finder = cv::ORB::create();
+        return cv::ORB::create();
     #endif
+    }
 
-        // Find features with ORB
-        std::vector <cv::detail::ImageFeatures> features(_cameras.size());
-        for (int i=0; i< _cameras.size(); i++) {
-            cv::Mat undistorted_img = _cameras[i]->read();
-            computeImageFeatures(finder, undistorted_img, features[i]);
-            features[i].img_idx = i;
+    // Work scale pixels around an inlier keypoint in which its features are searched again at full resolution
+    static const double refine_window_radius = 4.;
+
+    /**
+     * Features of a full resolution image, detected only in the windows around the inlier keypoints of its work
+     * scale features. _windows receives the full resolution keypoints of the window of each inlier keypoint.
+     */
+    static void find_window_features(const cv::Ptr<cv::Feature2D>& _finder, const cv::Mat& _full_img,
+                                     const cv::detail::ImageFeatures& _features, const double& _work_scale,
+                                     const std::vector<uchar>& _inliers, cv::detail::ImageFeatures& _full_features,
+                                     std::unordered_map<int, std::vector<int>>& _windows)
+    {
+        const int radius = cvCeil(refine_window_radius / _work_scale);
+        const cv::Rect img_rect(cv::Point(0, 0), _full_img.size());
+        cv::Mat mask = cv::Mat::zeros(_full_img.size(), CV_8U);
+        std::vector<std::pair<int, cv::Rect>> windows;
+        for (int k = 0; k < _features.keypoints.size(); k++) {
+            if (!_inliers[k])
+                continue;
+            const cv::Point center = _features.keypoints[k].pt / _work_scale;
+            const cv::Rect window = cv::Rect(center.x - radius, center.y - radius, 2*radius + 1, 2*radius + 1) & img_rect;
+            mask(window).setTo(255);
+            windows.emplace_back(k, window);
+        }
+
+        // Detection in the crop covering all the windows, the mask keeps the keypoints inside the windows
+        const cv::Rect crop = cv::boundingRect(mask);
+        _full_features.keypoints.clear();
+        _full_features.descriptors.release();
+        if (!crop.empty()) {
+            computeImageFeatures(_finder, _full_img(crop), _full_features, mask(crop));
+            for (auto& keypoint : _full_features.keypoints)
+                keypoint.pt += cv::Point2f(crop.tl());
+        }
+        _full_features.img_idx = _features.img_idx;
+        _full_features.img_size = _full_img.size();
+
+        for (const auto& window : windows) {
+            std::vector<int>& window_keypoints = _windows[window.first];
+            for (int p = 0; p < _full_features.keypoints.size(); p++)
+                if (window.second.contains(cv::Point(_full_features.keypoints[p].pt)))
+                    window_keypoints.push_back(p);
+        }
+    }
+
+    /**
+     * Full resolution matches of an image pair. The full resolution features in the windows of the two keypoints of
+     * each inlier match at work scale are matched with each other, then the homography, its inliers and the
+     * confidence of the pair are estimated as in cv::detail::BestOf2NearestMatcher.
+     */
+    static void match_in_windows(const cv::detail::MatchesInfo& _matches, const float& _match_conf,
+                                 const cv::detail::ImageFeatures& _src_features,
+                                 const std::unordered_map<int, std::vector<int>>& _src_windows,
+                                 const cv::detail::ImageFeatures& _dst_features,
+                                 const std::unordered_map<int, std::vector<int>>& _dst_windows,
+                                 cv::detail::MatchesInfo& _full_matches)
+    {
+        _full_matches.src_img_idx = _matches.src_img_idx;
+        _full_matches.dst_img_idx = _matches.dst_img_idx;
 
-            PLOGI << "\tFeatures in image #"<< i << " (" << _cameras[i]->get_name() << "): " << features[i].keypoints.size();
+        const cv::Mat src_descriptors = _src_features.descriptors.getMat(cv::ACCESS_READ);
+        const cv::Mat dst_descriptors = _dst_features.descriptors.getMat(cv::ACCESS_READ);
+        const int norm_type = src_descriptors.depth() == CV_8U ? cv::NORM_HAMMING : cv::NORM_L2;
+        std::set<std::pair<int, int>> matched;
+        for (int m = 0; m < _matches.matches.size(); m++) {
+            if (!_matches.inliers_mask[m])
+                continue;
+            const std::vector<int>& src_window = _src_windows.at(_matches.matches[m].queryIdx);
+            const std::vector<int>& dst_window = _dst_windows.at(_matches.matches[m].trainIdx);
+            for (const int& src_idx : src_window) {
+                // Nearest neighbour within the window, with the ratio test of the work scale matcher
+                int best_idx = -1;
+                double best_dist = DBL_MAX, second_dist = DBL_MAX;
+                for (const int& dst_idx : dst_window) {
+                    const double dist = cv::norm(src_descriptors.row(src_idx), dst_descriptors.row(dst_idx), norm_type);
+                    if (dist < best_dist) {
+                        second_dist = best_dist;
+                        best_dist = dist;
+                        best_idx = dst_idx;
+                    }
+                    else if (dist < second_dist)
+                        second_dist = dist;
+                }
+                if (best_idx >= 0 && best_dist < (1. - _match_conf) * second_dist
+                    && matched.emplace(src_idx, best_idx).second)
+                    _full_matches.matches.emplace_back(src_idx, best_idx, static_cast<float>(best_dist));
+            }
         }
+        if (_full_matches.matches.size() < 6)
+            return;
+
+        // Points relative to the image centers, as in the work scale matcher
+        std::vector<cv::Point2f> src_points, dst_points;
+        const cv::Point2f src_center(_src_features.img_size.width * 0.5f, _src_features.img_size.height * 0.5f);
+        const cv::Point2f dst_center(_dst_features.img_size.width * 0.5f, _dst_features.img_size.height * 0.5f);
+        for (const auto& match : _full_matches.matches) {
+            src_points.push_back(_src_features.keypoints[match.queryIdx].pt - src_center);
+            dst_points.push_back(_dst_features.keypoints[match.trainIdx].pt - dst_center);
+        }
+        _full_matches.H = cv::findHomography(src_points, dst_points, _full_matches.inliers_mask, cv::RANSAC);
+        if (_full_matches.H.empty())
+            return;
+        _full_matches.num_inliers = cv::countNonZero(_full_matches.inliers_mask);
+        _full_matches.confidence = _full_matches.num_inliers / (8 + 0.3 * _full_matches.matches.size());
+        // Too close images are not kept either
+        _full_matches.confidence = _full_matches.confidence > 3. ? 0. : _full_matches.confidence;
+    }
+
+    double Calibrator::get_work_scale(const cv::Size& _dims) const
+    {
+        if (m_work_megapix <= 0)
+            return 1.;
+        return std::min(1., std::sqrt(m_work_megapix * 1e6 / _dims.area()));
+    }
+
+    bool Calibrator::refine_matches(const std::vector<CameraCalibration*>& _cameras,
+                                    const std::vector<double>& _work_scales,
+                                    const std::vector<cv::detail::ImageFeatures>& _features,
+                                    const std::vector<cv::detail::MatchesInfo>& _pairwise_matches,
+                                    std::vector<cv::detail::ImageFeatures>& _full_features,
+                                    std::vector<cv::detail::MatchesInfo>& _full_matches) const
+    {
+        const int nr_images = _features.size();
+        assert(_pairwise_matches.size() == nr_images * nr_images);
+
+        // Keypoints of the inlier matches of the pairs used by the adjuster
+        std::vector<std::vector<uchar>> inliers(nr_images);
+        for (int i = 0; i < nr_images; i++)
+            inliers[i].assign(_features[i].keypoints.size(), 0);
+        for (const auto& matches_info : _pairwise_matches) {
+            if (matches_info.src_img_idx < 0 || matches_info.confidence < m_conf_thresh)
+                continue;
+            for (int m = 0; m < matches_info.matches.size(); m++) {
+                if (!matches_info.inliers_mask[m])
+                    continue;
+                inliers[matches_info.src_img_idx][matches_info.matches[m].queryIdx] = 1;
+                inliers[matches_info.dst_img_idx][matches_info.matches[m].trainIdx] = 1;
+            }
+        }
+
+        _full_features.resize(nr_images);
+        std::vector<std::unordered_map<int, std::vector<int>>> windows(nr_images);
+        cv::parallel_for_(cv::Range(0, nr_images), [&](const cv::Range& range) {
+            cv::Ptr<cv::Feature2D> finder = create_finder();
+            for (int i = range.start; i < range.end; i++) {
+                const int& cam_idx = _features[i].img_idx;
+                find_window_features(finder, _cameras[cam_idx]->read(), _features[i], _work_scales[cam_idx],
+                                     inliers[i], _full_features[i], windows[i]);
+            }
+        });
+
+        // Both directions of a pair are used by the adjusters: the second one is the first one inverted
+        _full_matches.assign(nr_images * nr_images, cv::detail::MatchesInfo());
+        std::vector<bool> is_matched(nr_images, false);
+        for (int i = 0; i < nr_images; i++) {
+            _full_matches[i * nr_images + i].src_img_idx = i;
+            _full_matches[i * nr_images + i].dst_img_idx = i;
+            for (int j = i + 1; j < nr_images; j++) {
+                const cv::detail::MatchesInfo& matches_info = _pairwise_matches[i * nr_images + j];
+                cv::detail::MatchesInfo& full_matches_info = _full_matches[i * nr_images + j];
+                full_matches_info.src_img_idx = i;
+                full_matches_info.dst_img_idx = j;
+                if (matches_info.confidence >= m_conf_thresh)
+                    match_in_windows(matches_info, m_features_conf_thresh, _full_features[i], windows[i],
+                                     _full_features[j], windows[j], full_matches_info);
+
+                cv::detail::MatchesInfo& dual_matches_info = _full_matches[j * nr_images + i];
+                dual_matches_info = full_matches_info;
+                std::swap(dual_matches_info.src_img_idx, dual_matches_info.dst_img_idx);
+                if (!full_matches_info.H.empty())
+                    dual_matches_info.H = full_matches_info.H.inv();
+                for (auto& match : dual_matches_info.matches)
+                    std::swap(match.queryIdx, match.trainIdx);
+
+                if (matches_info.confidence >= m_conf_thresh)
+                    PLOGI << "\tFull resolution matches of images #" << i << " and #" << j << ": "
+                          << full_matches_info.num_inliers << " inliers, confidence " << full_matches_info.confidence;
+                if (full_matches_info.confidence >= m_conf_thresh)
+                    is_matched[i] = is_matched[j] = true;
+            }
+        }
+        return std::all_of(is_matched.begin(), is_matched.end(), [](const bool& _matched) { return _matched; });
+    }
+
+    const std::vector<RotationCamera> Calibrator::calibrate(const std::vector<CameraCalibration*>& _cameras,
+                                                            const cv::Mat& _match_mask) {
+        assert(!_cameras.empty());
+        assert(_match_mask.empty() || (_match_mask.type() == CV_8UC1 &&
+               _match_mask.rows == _cameras.size() && _match_mask.cols == _cameras.size()));
+
+        // Read, undistort and find features of each image in parallel, at work scale
+        std::vector <cv::detail::ImageFeatures> features(_cameras.size());
+        std::vector<double> work_scales(_cameras.size());
+        cv::parallel_for_(cv::Range(0, _cameras.size()), [&](const cv::Range& range) {
+            // Feature detectors are not thread safe: one per worker
+            cv::Ptr<cv::Feature2D> finder = create_finder();
+            for (int i = range.start; i < range.end; i++) {
+                cv::Mat undistorted_img = _cameras[i]->read();
+                work_scales[i] = get_work_scale(undistorted_img.size());
+                if (work_scales[i] < 1.)
+                    cv::resize(undistorted_img, undistorted_img, cv::Size(), work_scales[i], work_scales[i],
+                               cv::INTER_AREA);
+                computeImageFeatures(finder, undistorted_img, features[i]);
+                features[i].img_idx = i;
+            }
+        });
+        for (int i=0; i< _cameras.size(); i++)
+            PLOGI << "\tFeatures in image #"<< i << " (" << _cameras[i]->get_name() << "): " << features[i].keypoints.size()
+                  << " at scale " << work_scales[i];
 
         //Pairwise matching
         std::vector <cv::detail::MatchesInfo> pairwise_matches;
         cv::detail::BestOf2NearestMatcher matcher(false, m_features_conf_thresh);
 
-        matcher(features, pairwise_matches);
+        if (_match_mask.empty())
+            matcher(features, pairwise_matches);
+        else {
+            PLOGI << "Matching " << (cv::countNonZero(_match_mask) - cv::countNonZero(_match_mask.diag())) / 2
+                  << " of the " << _cameras.size() * (_cameras.size() - 1) / 2 << " image pairs.";
+            matcher(features, pairwise_matches, _match_mask.getUMat(cv::ACCESS_READ));
+        }
         matcher.collectGarbage();
 
         // Leave only images we are sure are from the same panorama
@@ -79,11 +290,12 @@ namespace laz {
             intrinsic = _cameras[cam_idx]->get_intrinsic();
             intrinsic.convertTo(intrinsic64f, CV_64F);
 
+            const double& work_scale = work_scales[cam_idx];
             cv::detail::CameraParams& calibrated_params = cameras_params[i];
-            calibrated_params.focal = intrinsic64f.at<double>(0,0);
+            calibrated_params.focal = work_scale * intrinsic64f.at<double>(0,0);
             calibrated_params.aspect = intrinsic64f.at<double>(1,1)/intrinsic64f.at<double>(0,0);
-            calibrated_params.ppx = intrinsic64f.at<double>(0,2);
-            calibrated_params.ppy = intrinsic64f.at<double>(1,2);
+            calibrated_params.ppx = work_scale * intrinsic64f.at<double>(0,2);
+            calibrated_params.ppy = work_scale * intrinsic64f.at<double>(1,2);
         }
         if (!estimator(features, pairwise_matches, cameras_params)) {
             PLOGE << "Homography estimation failed.";
@@ -114,6 +326,30 @@ namespace laz {
             return {};
         }
 
+        // Back to full resolution: rotations are scale invariant
+        for (int i =0; i<features.size(); i++) {
+            const double& work_scale = work_scales[features[i].img_idx];
+            cameras_params[i].focal /= work_scale;
+            cameras_params[i].ppx /= work_scale;
+            cameras_params[i].ppy /= work_scale;
+        }
+
+        const bool is_downscaled = std::any_of(work_scales.begin(), work_scales.end(),
+                                               [](const double& _scale) { return _scale < 1.; });
+        if (m_refine_full_res && is_downscaled) {
+            std::vector<cv::detail::ImageFeatures> full_features;
+            std::vector<cv::detail::MatchesInfo> full_matches;
+            const bool is_refinable = this->refine_matches(_cameras, work_scales, features, pairwise_matches,
+                                                           full_features, full_matches);
+
+            // Full resolution adjustment, starting from the rescaled work scale solution
+            std::vector<cv::detail::CameraParams> refined_params = cameras_params;
+            if (is_refinable && (*adjuster)(full_features, full_matches, refined_params))
+                cameras_params = refined_params;
+            else
+                PLOGW << "Full resolution refinement failed, keeping the work scale calibration.";
+        }
+
         std::vector<cv::Mat> rmats;
         for (size_t i = 0; i < cameras_params.size(); ++i)
             rmats.push_back(cameras_params[i].R.clone());
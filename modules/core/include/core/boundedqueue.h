@@ -0,0 +1,85 @@
+#ifndef LIVESTITCHER_BOUNDEDQUEUE_H
+#define LIVESTITCHER_BOUNDEDQUEUE_H
+#include <deque>
+#include <mutex>
+#include <condition_variable>
+#include <assert.h>
+
+namespace laz {
+
+    /**
+     * Blocking FIFO of bounded capacity connecting a producer thread to a consumer thread.
+     * Once closed, push() fails and pop() drains the remaining items before failing.
+     */
+    template<typename T>
+    class BoundedQueue {
+    public:
+        explicit BoundedQueue(const int& _capacity) : m_capacity(_capacity), m_closed(false)
+        {
+            assert(m_capacity > 0);
+        }
+
+        BoundedQueue(const BoundedQueue&) = delete;
+        BoundedQueue& operator=(const BoundedQueue&) = delete;
+
+        /**
+         * Wait for a free slot and queue the item.
+         * @return false if the queue is closed, in which case the item is dropped
+         */
+        bool push(T _item)
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_not_full.wait(lock, [this]() { return m_closed || static_cast<int>(m_items.size()) < m_capacity; });
+            if (m_closed)
+                return false;
+            m_items.push_back(std::move(_item));
+            lock.unlock();
+            m_not_empty.notify_one();
+            return true;
+        }
+
+        /**
+         * Wait for an item and dequeue it.
+         * @return false if the queue is closed and empty
+         */
+        bool pop(T& _item)
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_not_empty.wait(lock, [this]() { return m_closed || !m_items.empty(); });
+            if (m_items.empty())
+                return false;
+            _item = std::move(m_items.front());
+            m_items.pop_front();
+            lock.unlock();
+            m_not_full.notify_one();
+            return true;
+        }
+
+        void close()
+        {
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                m_closed = true;
+            }
+            m_not_full.notify_all();
+            m_not_empty.notify_all();
+        }
+
+        int size() const
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            return m_items.size();
+        }
+
+        int capacity() const { return m_capacity; }
+
+    private:
+        const int m_capacity;
+        bool m_closed;
+        std::deque<T> m_items;
+        mutable std::mutex m_mutex;
+        std::condition_variable m_not_full;
+        std::condition_variable m_not_empty;
+    };
+} // namespace laz
+#endif //LIVESTITCHER_BOUNDEDQUEUE_H
@@ -0,0 +1,45 @@
+#ifndef LIVESTITCHER_BUNDLEGEOMETRY_H
+#define LIVESTITCHER_BUNDLEGEOMETRY_H
+#include <vector>
+#include <memory>
+#include <opencv2/core.hpp>
+
+namespace laz {
+
+    /**
+     * Immutable snapshot of the geometry of a camera bundle (masks, corners, sizes and top-left points).
+     * Snapshots are shared through BundleGeometryPtr: holders never copy the bundles, and a change of
+     * geometry produces a new snapshot instead of modifying the shared one.
+     */
+    class BundleGeometry {
+    public:
+        BundleGeometry(const std::vector<cv::Mat>& _mask_bundle,
+                       const std::vector<cv::Rect>& _corners_bundle,
+                       const std::vector<cv::Size>& _size_bundle);
+
+        int size() const { return m_mask_bundle.size(); }
+
+        const std::vector<cv::Mat>& get_mask_bundle() const { return m_mask_bundle; }
+        const std::vector<cv::Rect>& get_corners_bundle() const { return m_corners_bundle; }
+        const std::vector<cv::Size>& get_size_bundle() const { return m_size_bundle; }
+        const std::vector<cv::Point>& get_tl_point_bundle() const { return m_tl_point_bundle; }
+
+        /**
+         * True when both snapshots describe the same corners, sizes and mask contents.
+         */
+        bool same_as(const BundleGeometry& _other) const;
+
+        std::shared_ptr<const BundleGeometry> with_masks(const std::vector<cv::Mat>& _mask_bundle) const;
+        std::shared_ptr<const BundleGeometry> with_corners(const std::vector<cv::Rect>& _corners_bundle) const;
+        std::shared_ptr<const BundleGeometry> with_sizes(const std::vector<cv::Size>& _size_bundle) const;
+
+    private:
+        const std::vector<cv::Mat> m_mask_bundle;
+        const std::vector<cv::Rect> m_corners_bundle;
+        const std::vector<cv::Size> m_size_bundle;
+        const std::vector<cv::Point> m_tl_point_bundle;
+    };
+
+    typedef std::shared_ptr<const BundleGeometry> BundleGeometryPtr;
+} // namespace laz
+#endif //LIVESTITCHER_BUNDLEGEOMETRY_H
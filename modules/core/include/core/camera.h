@@ -3,6 +3,10 @@
 #include <assert.h>
 #include <vector>
 #include <string>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <functional>
 
 #include <opencv2/core.hpp>
 #include <opencv2/imgproc.hpp>
@@ -12,20 +16,44 @@
 #include <plog/Log.h>
 
 #include "core/math.h"
+#include "core/mapcache.h"
 
 #pragma once
 
 namespace laz {
 
+    enum MapMode {
+        FLOAT_MAPS = 0,     // CV_32FC1 x and y maps
+        COMPACT_MAPS        // CV_16SC2 maps + CV_16UC1 interpolation table (see cv::convertMaps)
+    };
+
+    /**
+     * Plain calibration of a camera, as parsed from a calibration json. Each camera type uses the fields of its
+     * level: dims for Camera, intrinsic and dist_coeffs for IntrinsicCamera, extrinsic for ExtrinsicCamera,
+     * rotation and radius for RotationCamera.
+     */
+    class CameraParameters {
+    public:
+        std::string name;
+        cv::Size dims;
+        cv::Mat intrinsic, dist_coeffs;
+        cv::Mat extrinsic;
+        cv::Mat rotation;
+        float radius = 0.f;
+    };
+
     class Camera{
     public:
-        Camera(const std::string& _name, const cv::Size& _dims) :  m_name(_name), m_dims(_dims) {};
+        Camera(const std::string& _name, const cv::Size& _dims);
         virtual ~Camera() {};
 
         void remap(cv::InputArray &_src, cv::OutputArray &_dst,
                    const int &interpolation=cv::INTER_LINEAR,
                    const int &borderMode=cv::BORDER_REFLECT,
                    const cv::Scalar &scalar=cv::Scalar(0)) const;
+        /**
+         * Valid pixels of the remapped images. Built once with the maps and shared: do not modify it.
+         */
         virtual cv::Mat get_mask() const;
         virtual cv::Rect get_corners() const {return cv::Rect(0,0,m_dims.width, m_dims.height);};
 
@@ -34,10 +62,60 @@ namespace laz {
 
         void set_name(const std::string& _name) { m_name = _name; }
 
+        /**
+         * Select the remap tables used by remap(). COMPACT_MAPS converts the merged float maps to fixed-point
+         * once, which more than halves the map memory traffic per frame at a 1/32 pixel precision.
+         * @param _mode : MapMode::FLOAT_MAPS or MapMode::COMPACT_MAPS
+         */
+        void set_map_mode(const MapMode& _mode) { m_map_mode = _mode; }
+        MapMode get_map_mode() const { return m_map_mode; }
+
+        /**
+         * Final remap tables, mask and corners of the camera, as stored in a MapCache.
+         */
+        CameraMaps get_maps() const;
+
+        /**
+         * Build the maps now instead of on the first remap.
+         */
+        void build_maps() const { this->get_map_set(); }
+
+        /**
+         * Number of map sets built by all the cameras of the process.
+         */
+        static long get_nr_map_builds() { return s_nr_map_builds; }
+
     protected:
+        /**
+         * Maps of a camera, built once on first use and shared by all the copies of the camera.
+         * Constructors changing the geometry start a new map set with the builder of their geometry.
+         */
+        class MapSet {
+        public:
+            explicit MapSet(const std::function<void(MapSet&)>& _build) : build(_build) {}
+
+            cv::Mat mapx, mapy;                         // Merged float maps
+            cv::Mat mask;                               // Remapped full image, unless set by the builder
+            cv::Mat compact_map1, compact_map2;         // Fixed-point conversion of the merged maps
+
+            std::function<void(MapSet&)> build;
+            std::once_flag built;
+            std::once_flag compact_built;
+        };
+
+        const MapSet& get_map_set() const;
+        const MapSet& get_compact_map_set() const;
+
+        void reset_maps(const std::function<void(MapSet&)>& _build);
+        void set_maps(const CameraMaps& _maps);
+
         std::string m_name;
-        cv::Mat m_mapx, m_mapy;
+        std::shared_ptr<MapSet> m_maps;
+        MapMode m_map_mode = MapMode::FLOAT_MAPS;
         const cv::Size m_dims;
+
+    private:
+        static std::atomic<long> s_nr_map_builds;
     };
 
     class IntrinsicCamera : public Camera {
@@ -51,22 +129,28 @@ namespace laz {
                         cv::InputArray _dist_coeffs,
                         const cv::Size& _dims);
 
+        explicit IntrinsicCamera(const CameraParameters& _parameters);
+
         virtual ~IntrinsicCamera() = default;
 
         float get_focal() const;
         cv::Mat get_intrinsic() const { return m_intrinsic; }
         cv::Mat get_dist_coeffs() const { return m_dist_coeffs; }
 
-    private:
-        void init_undistort_maps();
-
     protected:
+        /**
+         * Undistortion maps of the calibration, as built by the map set of the camera.
+         */
+        static void build_undistort_maps(const cv::Mat& _intrinsic, const cv::Mat& _dist_coeffs, const cv::Size& _dims,
+                                         cv::Mat& _mapx, cv::Mat& _mapy);
+
         const cv::Mat m_dist_coeffs, m_intrinsic;
     };
 
     class ExtrinsicCamera : public IntrinsicCamera {
     public:
         ExtrinsicCamera(const IntrinsicCamera &cam, cv::InputArray _extrinsic);
+        explicit ExtrinsicCamera(const CameraParameters& _parameters);
 
         cv::Mat get_extrinsic() const { return m_extrinsic; }
 
@@ -80,6 +164,9 @@ namespace laz {
         RotationCamera(const ExtrinsicCamera &_extrinsic_cam, cv::InputArray _rotation, const float& _rot_radius) :
                 ExtrinsicCamera(_extrinsic_cam), m_rotation(_rotation.getMat().clone()), m_rot_radius(_rot_radius)
         {};
+        explicit RotationCamera(const CameraParameters& _parameters) :
+                ExtrinsicCamera(_parameters), m_rotation(_parameters.rotation.clone()), m_rot_radius(_parameters.radius)
+        {};
         ~RotationCamera() = default;
 
         cv::Mat get_rotation() const { return m_rotation; }
@@ -88,16 +175,13 @@ namespace laz {
     protected:
         const float m_rot_radius;
         const cv::Mat m_rotation;
-        cv::Mat m_warp_mapx, m_warp_mapy;
     };
 
     class CylindricalCamera : public RotationCamera {
     public:
         explicit CylindricalCamera(const RotationCamera& _cam);
+        CylindricalCamera(const RotationCamera& _cam, const CameraMaps& _maps);
         ~CylindricalCamera() = default;
-
-    private:
-        void init_cylindrical_maps();
     };
 } // namespace laz
 #endif //LIVESTITCHER_CAMERA_H
@@ -1,9 +1,14 @@
 #ifndef LIVESTITCHER_CAMERASTREAM_H
 #define LIVESTITCHER_CAMERASTREAM_H
+#include <deque>
+#include <future>
+#include <memory>
 #include <opencv2/imgcodecs.hpp>
 
 #include "core/camera.h"
 #include "core/cvcamera.h"
+#include "core/threadpool.h"
+#include "core/latencyhistogram.h"
 
 namespace laz {
     enum StreamStatus {
@@ -30,10 +35,19 @@ namespace laz {
         virtual void reset(){};
         virtual cv::Mat read() const { return cv::Mat(); };
 
+        /**
+         * Durations of the image acquisition (ex. decoding) and of its remapping, for each streamed frame.
+         */
+        const LatencyHistogram& get_decode_latency() const { return m_decode_latency; }
+        const LatencyHistogram& get_remap_latency() const { return m_remap_latency; }
+
     protected:
         virtual StreamStatus _connect();
         virtual StreamStatus _disconnect();
 
+        mutable LatencyHistogram m_decode_latency;
+        mutable LatencyHistogram m_remap_latency;
+
         Camera const* m_cam;
         StreamStatus m_status;
     };
@@ -45,11 +59,18 @@ namespace laz {
     class CameraFakeStream : public CameraStream
     {
     public:
-        CameraFakeStream(Camera const* _cam, const std::vector<std::string>& _img_paths):
-                CameraStream(_cam), m_img_paths(_img_paths), m_read_idx(0) {};
-        virtual ~CameraFakeStream() = default;
-
-        virtual void reset() { m_read_idx = 0; }
+        /**
+         * @param _cam : Camera used to remap the loaded images
+         * @param _img_paths : Images streamed in order
+         * @param _prefetch_depth : Number of decoded and remapped frames kept ready ahead of read().
+         *                          0 disables prefetching.
+         * @param _nr_workers : Number of background threads decoding the prefetched frames.
+         */
+        CameraFakeStream(Camera const* _cam, const std::vector<std::string>& _img_paths,
+                         const int& _prefetch_depth=0, const int& _nr_workers=1);
+        virtual ~CameraFakeStream();
+
+        virtual void reset();
         virtual cv::Mat read() const;
         virtual cv::Mat read(const int& idx) const;
 
@@ -60,8 +81,16 @@ namespace laz {
         virtual StreamStatus _connect();
 
     private:
+        void fill_prefetch_ring() const;
+        void clear_prefetch_ring() const;
+
         mutable int m_read_idx;
         std::vector<std::string> m_img_paths;
+
+        const int m_prefetch_depth;
+        mutable int m_prefetch_idx;                                 // Next frame index to submit to the workers
+        mutable std::deque<std::future<cv::Mat>> m_prefetch_ring;   // Frames from m_read_idx to m_prefetch_idx
+        std::unique_ptr<ThreadPool> m_prefetch_workers;
     };
 
 
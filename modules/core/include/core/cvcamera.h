@@ -10,6 +10,11 @@ namespace laz {
     class CvCylindricalCamera : public RotationCamera {
     public:
         explicit CvCylindricalCamera(const RotationCamera& _cam);
+
+        /**
+         * Camera using the maps, mask and corners of a MapCache instead of building its projection.
+         */
+        CvCylindricalCamera(const RotationCamera& _cam, const CameraMaps& _maps);
         virtual ~CvCylindricalCamera() = default;
 
         /*
@@ -18,24 +23,34 @@ namespace laz {
                            const int &borderMode=cv::BORDER_REFLECT) const;
          */
 
-        virtual cv::Mat get_mask() const override;
-        virtual cv::Rect get_corners() const override;
+        /**
+         * Bounding box of the camera in the mosaic, computed at construction.
+         */
+        virtual cv::Rect get_corners() const override { return m_corners; }
 
     protected:
-        cv::Rect m_corners;
+        /**
+         * The projection is given at construction: the maps are built lazily, after the derived
+         * constructors have run.
+         */
+        CvCylindricalCamera(const RotationCamera& _cam, const cv::Ptr<cv::WarperCreator>& _warper_creator);
+        CvCylindricalCamera(const RotationCamera& _cam, const cv::Ptr<cv::WarperCreator>& _warper_creator,
+                            const CameraMaps& _maps);
+
+        cv::Ptr<cv::detail::RotationWarper> create_warper() const;
+        cv::Rect compute_corners() const;
 
-    private:
-        void init_cylindrical_maps();
-        virtual cv::Ptr<cv::WarperCreator> create_cvwarper() const;
+        const cv::Ptr<cv::WarperCreator> m_warper_creator;
+        const cv::Rect m_corners;
     };
 
     class CvSphericalCamera : public CvCylindricalCamera {
     public:
-        explicit CvSphericalCamera(const RotationCamera &_cam) : CvCylindricalCamera(_cam) {};
+        explicit CvSphericalCamera(const RotationCamera &_cam) :
+                CvCylindricalCamera(_cam, cv::makePtr<cv::SphericalWarper>()) {};
+        CvSphericalCamera(const RotationCamera &_cam, const CameraMaps& _maps) :
+                CvCylindricalCamera(_cam, cv::makePtr<cv::SphericalWarper>(), _maps) {};
         virtual ~CvSphericalCamera() = default;
-
-    private:
-        virtual cv::Ptr<cv::WarperCreator> create_cvwarper() const override;
     };
 } // namespace laz
 
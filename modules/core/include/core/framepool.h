@@ -0,0 +1,61 @@
+#ifndef LIVESTITCHER_FRAMEPOOL_H
+#define LIVESTITCHER_FRAMEPOOL_H
+#include <vector>
+#include <unordered_map>
+#include <mutex>
+#include <atomic>
+#include <opencv2/core.hpp>
+
+namespace laz {
+
+    /**
+     * cv::MatAllocator recycling the released Mat buffers, keyed by their size in bytes. Once installed with
+     * cv::Mat::setDefaultAllocator(), the frames decoded, remapped, corrected and blended at a steady frame
+     * size reuse the Mat buffers of the previous frames.
+     * Mats keep a pointer to their allocator: the pool must outlive every Mat it allocated.
+     *
+     * Only Mat buffers go through the pool. Heap allocations left on every frame of a warm sequential Stitcher:
+     *  - the job of each cv::parallel_for_ call when OpenCV runs more than one thread,
+     *  - the decoding of CameraFakeStream, and its prefetch task and future,
+     *  - the cv::detail blenders and compensators, whose internals are only covered for Mat buffers,
+     *  - the Frame and queue nodes of the pipelined Stitcher,
+     *  - the seam masks of a frame and the background update tasks, when an update is requested.
+     */
+    class FramePoolAllocator : public cv::MatAllocator {
+    public:
+        /**
+         * @param _max_pooled_bytes : released buffers beyond this amount of idle memory are freed. The UMatData
+         *                            wrapping user data, e.g. for Mat::getUMat(), are always recycled
+         */
+        explicit FramePoolAllocator(const size_t& _max_pooled_bytes=size_t(1) << 30);
+        virtual ~FramePoolAllocator();
+
+        FramePoolAllocator(const FramePoolAllocator&) = delete;
+        FramePoolAllocator& operator=(const FramePoolAllocator&) = delete;
+
+        cv::UMatData* allocate(int _dims, const int* _sizes, int _type, void* _data, size_t* _step,
+                               cv::AccessFlag _flags, cv::UMatUsageFlags _usage_flags) const override;
+        bool allocate(cv::UMatData* _u, cv::AccessFlag _access_flags, cv::UMatUsageFlags _usage_flags) const override;
+        void deallocate(cv::UMatData* _u) const override;
+
+        /**
+         * Free the idle buffers and UMatData.
+         */
+        void clear();
+
+        long get_nr_allocations() const { return m_nr_allocations; }   // Buffers and UMatData obtained from the heap
+        long get_nr_reuses() const { return m_nr_reuses; }             // Buffers and UMatData served from the pool
+        size_t get_pooled_bytes() const;
+
+    private:
+        const size_t m_max_pooled_bytes;
+        mutable std::mutex m_mutex;
+        mutable std::unordered_map<size_t, std::vector<cv::UMatData*>> m_free_buffers;
+        mutable std::vector<cv::UMatData*> m_free_headers;   // Bookkeeping of released USER_ALLOCATED data
+        mutable size_t m_pooled_bytes;
+        mutable std::atomic<long> m_nr_allocations;
+        mutable std::atomic<long> m_nr_reuses;
+    };
+
+} // namespace laz
+#endif //LIVESTITCHER_FRAMEPOOL_H
@@ -0,0 +1,68 @@
+#ifndef LIVESTITCHER_LATENCYHISTOGRAM_H
+#define LIVESTITCHER_LATENCYHISTOGRAM_H
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <chrono>
+
+#include "nlohmann/json.hpp"
+
+namespace laz {
+
+    /**
+     * Summary of a LatencyHistogram, in milliseconds.
+     */
+    class LatencySummary {
+    public:
+        uint64_t count = 0;
+        double mean_ms = 0.;
+        double p50_ms = 0.;
+        double p99_ms = 0.;
+        double max_ms = 0.;
+
+        nlohmann::json to_json() const;
+    };
+
+    /**
+     * Lock-free latency histogram. Durations are counted in microsecond buckets of logarithmic width (16 buckets
+     * per power of two, percentiles within 6%) so that record() is a few relaxed atomic operations and can be
+     * called from any thread on every frame.
+     */
+    class LatencyHistogram {
+    public:
+        LatencyHistogram();
+
+        LatencyHistogram(const LatencyHistogram&) = delete;
+        LatencyHistogram& operator=(const LatencyHistogram&) = delete;
+
+        void record(const double& _ms);
+
+        /**
+         * Record the time elapsed since _start.
+         * @return the recorded duration, in milliseconds
+         */
+        double record_since(const std::chrono::steady_clock::time_point& _start);
+
+        /**
+         * Consistent enough for monitoring: concurrent records may land between the reads of two buckets.
+         */
+        LatencySummary summary() const;
+
+        void reset();
+
+    private:
+        static const int SUB_BUCKET_BITS = 4;
+        static const int SUB_BUCKETS = 1 << SUB_BUCKET_BITS;
+        static const int NR_BUCKETS = SUB_BUCKETS + (64 - SUB_BUCKET_BITS) * SUB_BUCKETS;
+
+        static int bucket_index(const uint64_t& _us);
+        static uint64_t bucket_value(const int& _idx);
+
+        std::array<std::atomic<uint64_t>, NR_BUCKETS> m_buckets;
+        std::atomic<uint64_t> m_count;
+        std::atomic<uint64_t> m_sum_us;
+        std::atomic<uint64_t> m_max_us;
+    };
+
+} // namespace laz
+#endif //LIVESTITCHER_LATENCYHISTOGRAM_H
@@ -0,0 +1,54 @@
+#ifndef LIVESTITCHER_MAPCACHE_H
+#define LIVESTITCHER_MAPCACHE_H
+#include <string>
+#include <opencv2/core.hpp>
+
+namespace laz {
+
+    /**
+     * Final geometry of a camera: merged remap tables, warped mask and corners in the mosaic.
+     */
+    class CameraMaps {
+    public:
+        cv::Mat mapx, mapy;     // CV_32FC1
+        cv::Mat mask;           // CV_8UC1
+        cv::Rect corners;
+    };
+
+    /**
+     * On-disk cache of CameraMaps, one binary file per key in a cache directory. Loaded maps are memory mapped
+     * copy-on-write: no decoding nor copy at load, and the mapping is released with the last Mat referencing it.
+     */
+    class MapCache {
+    public:
+        /**
+         * @param _cache_dir : Directory of the cache files, created if missing
+         */
+        explicit MapCache(const std::string& _cache_dir);
+
+        /**
+         * Key of a camera geometry.
+         * @param _parameters : Serialized calibration of the camera (ex. its calibration json entry)
+         * @param _warper : Type of projection applied after undistortion
+         */
+        static std::string make_key(const std::string& _parameters, const std::string& _warper);
+
+        /**
+         * @return false if the key is not cached, or if its file is truncated or from another cache version
+         */
+        bool load(const std::string& _key, CameraMaps& _maps) const;
+
+        /**
+         * Write the maps of a key. The file is written aside then renamed, so that concurrent loads never
+         * see a partial file.
+         */
+        void store(const std::string& _key, const CameraMaps& _maps) const;
+
+        std::string get_path(const std::string& _key) const;
+
+    private:
+        const std::string m_cache_dir;
+    };
+
+} // namespace laz
+#endif //LIVESTITCHER_MAPCACHE_H
@@ -17,6 +17,20 @@ namespace math{
      * @return cv::Rect
      */
     cv::Rect to_bbox(cv::InputArray _src);
+
+    /**
+     * Build the cylindrical warp maps of an image. For each pixel (i, j), the normalized coordinates
+     * n = _backward * (i, j, 1) are projected on the cylinder (sin(n0), n1, cos(n0)) and brought back to
+     * image coordinates with _forward. Coordinates falling outside of _dims are set to -1.
+     * Rows are processed in parallel and vectorized with universal intrinsics.
+     * @param _forward : virtual_intrinsic * extrinsic
+     * @param _backward : virtual_intrinsic^-1 * extrinsic^-1
+     * @param _dims : size of the maps
+     * @param _mapx : CV_32FC1 output map
+     * @param _mapy : CV_32FC1 output map
+     */
+    void build_cylindrical_maps(const cv::Matx33f& _forward, const cv::Matx33f& _backward, const cv::Size& _dims,
+                                cv::OutputArray _mapx, cv::OutputArray _mapy);
 } // namespace math
 
 
@@ -0,0 +1,26 @@
+#ifndef LIVESTITCHER_PARALLEL_H
+#define LIVESTITCHER_PARALLEL_H
+#include <opencv2/core/utility.hpp>
+
+namespace laz {
+
+    /**
+     * cv::parallel_for_ over a callable taking a cv::Range. Unlike the lambda overload of OpenCV, the callable is
+     * not wrapped in a std::function, which goes to the heap as soon as it captures more than two references:
+     * use it in the per-frame loops.
+     */
+    template<typename F>
+    void parallel_for_ref(const cv::Range& _range, const F& _body, const double& _nstripes=-1.)
+    {
+        class BodyRef : public cv::ParallelLoopBody {
+        public:
+            explicit BodyRef(const F& _f) : m_body(_f) {}
+            void operator()(const cv::Range& _r) const override { m_body(_r); }
+
+        private:
+            const F& m_body;
+        };
+        cv::parallel_for_(_range, BodyRef(_body), _nstripes);
+    }
+} // namespace laz
+#endif //LIVESTITCHER_PARALLEL_H
@@ -0,0 +1,129 @@
+#ifndef LIVESTITCHER_SHMRING_H
+#define LIVESTITCHER_SHMRING_H
+#include <string>
+#include <atomic>
+#include <cstdint>
+#include <opencv2/core.hpp>
+
+namespace laz {
+
+    /**
+     * Layout of the shared memory ring: a ShmRingHeader followed by nr_slots slots of slot_stride bytes.
+     * Each slot is a ShmSlotHeader followed by the pixel data of one mosaic.
+     */
+    struct ShmRingHeader {
+        uint32_t magic;
+        uint32_t version;
+        uint32_t nr_slots;
+        uint32_t reserved;
+        uint64_t slot_capacity;             // Bytes of pixel data per slot
+        uint64_t slot_stride;               // Bytes between two slots, header included
+        std::atomic<uint64_t> write_seq;    // Sequence number of the last published frame, 0 before the first
+    };
+
+    struct ShmSlotHeader {
+        std::atomic<uint64_t> seq;          // Sequence number of the frame in the slot, 0 while it is written
+        int32_t rows;
+        int32_t cols;
+        int32_t type;                       // OpenCV type, ex. CV_8UC3
+        int32_t reserved;
+        uint64_t step;
+        int64_t timestamp_us;               // Publication time, on the steady clock shared by the processes
+    };
+
+    static_assert(std::atomic<uint64_t>::is_always_lock_free, "Shared memory sequence numbers must be lock free");
+
+    /**
+     * Frame read in place from the ring. The image points into the shared memory: it stays valid until the
+     * producer wraps around and overwrites the slot, see ShmRingReader::is_valid().
+     */
+    class ShmFrame {
+    public:
+        uint64_t seq = 0;
+        int64_t timestamp_us = 0;
+        cv::Mat image;
+    };
+
+    /**
+     * Producer side of a POSIX shared memory ring of preallocated mosaic slots. Frames are written in place and
+     * published with increasing sequence numbers; the producer never waits for the consumers, which detect the
+     * frames overwritten while they read them.
+     */
+    class ShmRingWriter {
+    public:
+        /**
+         * Create (or recreate) the shared memory object.
+         * @param _name : POSIX shared memory name, ex. "/laz_mosaic"
+         * @param _slot_capacity : maximum size in bytes of a mosaic
+         */
+        ShmRingWriter(const std::string& _name, const int& _nr_slots, const size_t& _slot_capacity);
+        ~ShmRingWriter();
+
+        ShmRingWriter(const ShmRingWriter&) = delete;
+        ShmRingWriter& operator=(const ShmRingWriter&) = delete;
+
+        /**
+         * Claim the next slot and describe its content. Calling it again before commit() reuses the same slot.
+         * @return continuous image pointing into the slot
+         */
+        cv::Mat begin_write(const cv::Size& _size, const int& _type);
+
+        /**
+         * Publish the slot claimed by begin_write().
+         * @return sequence number of the published frame
+         */
+        uint64_t commit();
+
+        const std::string& get_name() const { return m_name; }
+        int get_nr_slots() const { return m_header->nr_slots; }
+        size_t get_slot_capacity() const { return m_header->slot_capacity; }
+
+    private:
+        ShmSlotHeader* get_slot(const uint64_t& _seq) const;
+
+        std::string m_name;
+        size_t m_mapped_size;
+        ShmRingHeader* m_header;
+        uint64_t m_next_seq;
+        bool m_writing;
+    };
+
+    /**
+     * Consumer side of a ShmRingWriter ring, mapped read only.
+     */
+    class ShmRingReader {
+    public:
+        explicit ShmRingReader(const std::string& _name);
+        ~ShmRingReader();
+
+        ShmRingReader(const ShmRingReader&) = delete;
+        ShmRingReader& operator=(const ShmRingReader&) = delete;
+
+        /**
+         * Wait for the frame following the last one read. A reader that fell behind by more than the ring size
+         * jumps to the oldest frame still available; the skipped frames are counted as dropped.
+         * @param _timeout_ms : maximum waiting time, negative to wait forever
+         * @return false on timeout
+         */
+        bool read(ShmFrame& _frame, const int& _timeout_ms=-1);
+
+        /**
+         * @return true if the frame has not been overwritten since it was read. Check it after consuming the image.
+         */
+        bool is_valid(const ShmFrame& _frame) const;
+
+        uint64_t get_nr_dropped() const { return m_nr_dropped; }
+        int get_nr_slots() const { return m_header->nr_slots; }
+
+    private:
+        const ShmSlotHeader* get_slot(const uint64_t& _seq) const;
+
+        std::string m_name;
+        size_t m_mapped_size;
+        const ShmRingHeader* m_header;
+        uint64_t m_last_seq;
+        uint64_t m_nr_dropped;
+    };
+
+} // namespace laz
+#endif //LIVESTITCHER_SHMRING_H
@@ -1,14 +1,24 @@
 #ifndef LIVESTITCHER_STREAMBUNDLER_H
 #define LIVESTITCHER_STREAMBUNDLER_H
 #include <memory.h>
+#include <memory>
+#include <chrono>
 #include "core/camerastream.h"
+#include "core/bundlegeometry.h"
+#include "core/threadpool.h"
+#include "core/latencyhistogram.h"
 #include "nlohmann/json.hpp"
 
 namespace laz {
 
     class StreamBundler {
     public:
-        StreamBundler(const std::vector<CameraStream*>& _streams);
+        /**
+         * @param _streams : Bundled camera streams
+         * @param _nr_workers : Number of persistent threads reading the streams in parallel.
+         *                      0 reads the streams one after another in the calling thread.
+         */
+        StreamBundler(const std::vector<CameraStream*>& _streams, const int& _nr_workers=0);
         virtual ~StreamBundler();
 
         virtual StreamStatus connect() {
@@ -51,11 +61,34 @@ namespace laz {
 
         std::vector<cv::Mat> read() const;
 
-        std::vector<cv::Mat> get_mask_bundle() const;
+        /**
+         * Read the streams into a caller bundle, reusing its storage: nothing is allocated but the images.
+         * Images are left empty if the bundle or one of its cameras is not connected.
+         */
+        void read(std::vector<cv::Mat>& _img_bundle) const;
 
-        std::vector<cv::Rect> get_corners_bundle() const;
+        /**
+         * Per camera duration of the last read(), in milliseconds, in the same order as the streams.
+         */
+        std::vector<double> get_read_latencies() const { return m_read_latencies; }
 
-        std::vector<cv::Size> get_size_bundle() const;
+        /**
+         * Durations of all the reads of a camera, decoding and remapping included.
+         */
+        const LatencyHistogram& get_read_histogram(const int& _idx) const { return m_read_histograms.at(_idx); }
+
+        const CameraStream& get_stream(const int& _idx) const { return *m_streams.at(_idx); }
+
+        const std::vector<cv::Mat>& get_mask_bundle() const;
+
+        const std::vector<cv::Rect>& get_corners_bundle() const;
+
+        const std::vector<cv::Size>& get_size_bundle() const;
+
+        /**
+         * Shared immutable snapshot of the bundle geometry, computed once from the streams.
+         */
+        BundleGeometryPtr get_geometry() const;
 
 
 
@@ -63,24 +96,30 @@ namespace laz {
 
     protected:
         void init_cache() const;
+        cv::Mat timed_read(const int& _idx) const;
 
         mutable StreamStatus m_bundle_status;
 
         class CachedBundle {
         public:
-            std::vector<cv::Mat> mask_bundle;
-            std::vector<cv::Rect> corners_bundle;
-            std::vector<cv::Size> size_bundle;
+            BundleGeometryPtr geometry;
+
+            bool empty() const { return !geometry; }
+            const std::vector<cv::Mat>& get_mask_bundle() const { return geometry->get_mask_bundle(); }
+            const std::vector<cv::Rect>& get_corners_bundle() const { return geometry->get_corners_bundle(); }
+            const std::vector<cv::Size>& get_size_bundle() const { return geometry->get_size_bundle(); }
 
             void reset() {
-                corners_bundle.clear();
-                mask_bundle.clear();
-                size_bundle.clear();
+                geometry.reset();
             }
         };
 
         mutable CachedBundle m_cache;
         std::vector<CameraStream*> m_streams{};
+
+        mutable std::vector<double> m_read_latencies;
+        mutable std::vector<LatencyHistogram> m_read_histograms;
+        std::unique_ptr<ThreadPool> m_read_workers;
     };
 } // namespace laz
 #endif //LIVESTITCHER_STREAMBUNDLER_H
@@ -0,0 +1,86 @@
+#ifndef LIVESTITCHER_THREADPOOL_H
+#define LIVESTITCHER_THREADPOOL_H
+#include <vector>
+#include <queue>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <memory>
+#include <type_traits>
+#include <exception>
+
+namespace laz {
+
+    /**
+     * Fixed size pool of persistent worker threads consuming a FIFO of tasks.
+     */
+    class ThreadPool {
+    public:
+        explicit ThreadPool(const int& _nr_workers);
+        virtual ~ThreadPool();
+
+        ThreadPool(const ThreadPool&) = delete;
+        ThreadPool& operator=(const ThreadPool&) = delete;
+
+        /**
+         * Queue a task for execution by the workers.
+         * @param _task : callable without arguments
+         * @return future holding the task result (or its exception)
+         */
+        template<typename F>
+        std::future<std::invoke_result_t<F>> submit(F&& _task)
+        {
+            using R = std::invoke_result_t<F>;
+            auto packaged_task = std::make_shared<std::packaged_task<R()>>(std::forward<F>(_task));
+            std::future<R> result = packaged_task->get_future();
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                m_tasks.emplace([packaged_task]() { (*packaged_task)(); });
+            }
+            m_condition.notify_one();
+            return result;
+        }
+
+        /**
+         * Run _task(i) for each i in [0, _nr_tasks) on the workers and wait for all of them. Unlike submit(),
+         * nothing is allocated, which suits the fan-outs of every frame. Concurrent batches run one after another,
+         * and must not be started from a task of the same pool.
+         * @param _task : callable taking the task index, rethrows the first exception of the batch
+         */
+        template<typename F>
+        void parallel_for(const int& _nr_tasks, const F& _task)
+        {
+            this->run_batch(_nr_tasks, &_task, [](const void* _ctx, const int& _idx) {
+                (*static_cast<const F*>(_ctx))(_idx);
+            });
+        }
+
+        int size() const { return m_workers.size(); }
+
+    private:
+        using BatchInvoker = void (*)(const void*, const int&);
+
+        void worker_loop();
+        void run_batch(const int& _nr_tasks, const void* _ctx, const BatchInvoker& _invoke);
+        void run_batch_task(const int& _idx);
+
+        std::vector<std::thread> m_workers;
+        std::queue<std::function<void()>> m_tasks;
+        std::mutex m_mutex;
+        std::condition_variable m_condition;
+        bool m_stop;
+
+        // Current parallel_for() batch, guarded by m_mutex
+        std::mutex m_batch_mutex;
+        std::condition_variable m_batch_done;
+        const void* m_batch_ctx;
+        BatchInvoker m_batch_invoke;
+        int m_batch_size;       // Number of tasks of the batch, 0 without batch
+        int m_batch_next;       // Next task index handed to a worker
+        int m_batch_pending;    // Tasks not completed yet
+        std::exception_ptr m_batch_error;
+    };
+} // namespace laz
+#endif //LIVESTITCHER_THREADPOOL_H
@@ -0,0 +1,62 @@
+#include "core/bundlegeometry.h"
+#include <assert.h>
+
+namespace laz {
+
+    static std::vector<cv::Point> to_tl_points(const std::vector<cv::Rect>& _corners_bundle)
+    {
+        std::vector<cv::Point> tl_point_bundle(_corners_bundle.size());
+        for (int i = 0; i < tl_point_bundle.size(); i++)
+            tl_point_bundle[i] = _corners_bundle.at(i).tl();
+        return tl_point_bundle;
+    }
+
+    BundleGeometry::BundleGeometry(const std::vector<cv::Mat>& _mask_bundle,
+                                   const std::vector<cv::Rect>& _corners_bundle,
+                                   const std::vector<cv::Size>& _size_bundle) :
+            m_mask_bundle(_mask_bundle),
+            m_corners_bundle(_corners_bundle),
+            m_size_bundle(_size_bundle),
+            m_tl_point_bundle(to_tl_points(_corners_bundle))
+    {
+        assert(m_mask_bundle.size() == m_corners_bundle.size());
+        assert(m_mask_bundle.size() == m_size_bundle.size());
+    }
+
+    bool BundleGeometry::same_as(const BundleGeometry& _other) const
+    {
+        if (this == &_other)
+            return true;
+        if (m_corners_bundle != _other.m_corners_bundle || m_size_bundle != _other.m_size_bundle)
+            return false;
+        if (m_mask_bundle.size() != _other.m_mask_bundle.size())
+            return false;
+        for (int i = 0; i < m_mask_bundle.size(); i++)
+        {
+            const cv::Mat& mask = m_mask_bundle[i];
+            const cv::Mat& other_mask = _other.m_mask_bundle[i];
+            if (mask.size() != other_mask.size() || mask.type() != other_mask.type())
+                return false;
+            if (mask.data == other_mask.data || mask.empty())
+                continue;
+            if (cv::norm(mask, other_mask, cv::NORM_INF) != 0.)
+                return false;
+        }
+        return true;
+    }
+
+    BundleGeometryPtr BundleGeometry::with_masks(const std::vector<cv::Mat>& _mask_bundle) const
+    {
+        return std::make_shared<const BundleGeometry>(_mask_bundle, m_corners_bundle, m_size_bundle);
+    }
+
+    BundleGeometryPtr BundleGeometry::with_corners(const std::vector<cv::Rect>& _corners_bundle) const
+    {
+        return std::make_shared<const BundleGeometry>(m_mask_bundle, _corners_bundle, m_size_bundle);
+    }
+
+    BundleGeometryPtr BundleGeometry::with_sizes(const std::vector<cv::Size>& _size_bundle) const
+    {
+        return std::make_shared<const BundleGeometry>(m_mask_bundle, m_corners_bundle, _size_bundle);
+    }
+} // namespace laz
@@ -6,22 +6,92 @@ namespace laz {
     // ----------------------------------------------------------------------------------------------
     // Camera (Base Class)
     // ----------------------------------------------------------------------------------------------
+    std::atomic<long> Camera::s_nr_map_builds(0);
+
+    Camera::Camera(const std::string& _name, const cv::Size& _dims) :  m_name(_name), m_dims(_dims)
+    {
+        // No maps at this level
+        this->reset_maps(nullptr);
+    }
+
     void Camera::remap(cv::InputArray &_src, cv::OutputArray &_dst,
                                 const int &interpolation,
                                 const int &borderMode,
                                 const cv::Scalar &scalar) const
     {
-        assert(!m_mapx.empty() and !m_mapy.empty());
-        cv::remap(_src, _dst, m_mapx, m_mapy, interpolation, borderMode, scalar);
+        // Nearest neighbour lookups keep the float maps: the fixed-point maps truncate instead of rounding.
+        if (m_map_mode == MapMode::COMPACT_MAPS and interpolation != cv::INTER_NEAREST)
+        {
+            const MapSet& maps = this->get_compact_map_set();
+            assert(!maps.compact_map1.empty() and !maps.compact_map2.empty());
+            cv::remap(_src, _dst, maps.compact_map1, maps.compact_map2, interpolation, borderMode, scalar);
+            return;
+        }
+        const MapSet& maps = this->get_map_set();
+        assert(!maps.mapx.empty() and !maps.mapy.empty());
+        cv::remap(_src, _dst, maps.mapx, maps.mapy, interpolation, borderMode, scalar);
+    }
+
+    const Camera::MapSet& Camera::get_map_set() const
+    {
+        MapSet& maps = *m_maps;
+        std::call_once(maps.built, [&maps, dims = m_dims]() {
+            if (!maps.build)
+                return;
+            maps.build(maps);
+            if (maps.mask.empty() and !maps.mapx.empty())
+            {
+                // Mask must be remapped with INTER_NEAREST and BORDER_CONSTANT
+                cv::Mat full_mask(dims, CV_8UC1, cv::Scalar(255));
+                cv::remap(full_mask, maps.mask, maps.mapx, maps.mapy, cv::INTER_NEAREST, cv::BORDER_CONSTANT,
+                          cv::Scalar(0));
+            }
+            s_nr_map_builds++;
+        });
+        return maps;
+    }
+
+    const Camera::MapSet& Camera::get_compact_map_set() const
+    {
+        this->get_map_set();
+        MapSet& maps = *m_maps;
+        std::call_once(maps.compact_built, [&maps]() {
+            if (!maps.mapx.empty() and !maps.mapy.empty())
+                cv::convertMaps(maps.mapx, maps.mapy, maps.compact_map1, maps.compact_map2, CV_16SC2, false);
+        });
+        return maps;
+    }
+
+    void Camera::reset_maps(const std::function<void(MapSet&)>& _build)
+    {
+        m_maps = std::make_shared<MapSet>(_build);
+    }
+
+    void Camera::set_maps(const CameraMaps& _maps)
+    {
+        assert(_maps.mapx.type() == CV_32FC1 && _maps.mapy.type() == CV_32FC1);
+        const cv::Mat mapx = _maps.mapx, mapy = _maps.mapy, mask = _maps.mask;
+        this->reset_maps([mapx, mapy, mask](MapSet& _map_set) {
+            _map_set.mapx = mapx;
+            _map_set.mapy = mapy;
+            _map_set.mask = mask;
+        });
+    }
+
+    CameraMaps Camera::get_maps() const
+    {
+        const MapSet& map_set = this->get_map_set();
+        CameraMaps maps;
+        maps.mapx = map_set.mapx;
+        maps.mapy = map_set.mapy;
+        maps.mask = this->get_mask();
+        maps.corners = this->get_corners();
+        return maps;
     }
 
     cv::Mat Camera::get_mask() const
     {
-        // Create mask
-        cv::Mat mask(m_dims, CV_8UC1, cv::Scalar(255)), warped_mask;
-        // Mask must be remapped with INTER_NEAREST and BORDER_CONSTANT
-        this->remap(mask, warped_mask, cv::INTER_NEAREST, cv::BORDER_CONSTANT, cv::Scalar(0));
-        return warped_mask;
+        return this->get_map_set().mask;
     }
 
     // ----------------------------------------------------------------------------------------------
@@ -34,13 +104,21 @@ namespace laz {
                                      m_intrinsic(_intrinsic.getMat().clone()),
                                      m_dist_coeffs(_dist_coeffs.getMat().clone())
     {
-        this->init_undistort_maps();
+        const cv::Mat intrinsic = m_intrinsic, dist_coeffs = m_dist_coeffs;
+        const cv::Size dims = m_dims;
+        this->reset_maps([intrinsic, dist_coeffs, dims](MapSet& _maps) {
+            build_undistort_maps(intrinsic, dist_coeffs, dims, _maps.mapx, _maps.mapy);
+        });
     }
 
-    void IntrinsicCamera::init_undistort_maps()
+    IntrinsicCamera::IntrinsicCamera(const CameraParameters& _parameters) :
+            IntrinsicCamera(Camera(_parameters.name, _parameters.dims), _parameters.intrinsic, _parameters.dist_coeffs)
+    {}
+
+    void IntrinsicCamera::build_undistort_maps(const cv::Mat& _intrinsic, const cv::Mat& _dist_coeffs,
+                                               const cv::Size& _dims, cv::Mat& _mapx, cv::Mat& _mapy)
     {
-        cv::initUndistortRectifyMap(m_intrinsic, m_dist_coeffs, cv::Mat(), m_intrinsic,
-                                    m_dims, CV_32FC1, m_mapx, m_mapy);
+        cv::initUndistortRectifyMap(_intrinsic, _dist_coeffs, cv::Mat(), _intrinsic, _dims, CV_32FC1, _mapx, _mapy);
     }
 
     float IntrinsicCamera::get_focal() const
@@ -59,6 +137,10 @@ namespace laz {
             IntrinsicCamera(_cam), m_extrinsic(_extrinsic.getMat().clone())
     {}
 
+    ExtrinsicCamera::ExtrinsicCamera(const CameraParameters& _parameters) :
+            IntrinsicCamera(_parameters), m_extrinsic(_parameters.extrinsic.clone())
+    {}
+
     cv::Rect ExtrinsicCamera::_get_corners() const
     {
         // Homogenous declaration
@@ -86,42 +168,35 @@ namespace laz {
     // ----------------------------------------------------------------------------------------------
     CylindricalCamera::CylindricalCamera(const RotationCamera& _cam) : RotationCamera(_cam)
     {
-        this->init_cylindrical_maps();
-    }
-
-    void CylindricalCamera::init_cylindrical_maps(){
         // This function returns the cylindrical warp for a given image and intrinsics matrix K
         float virtual_intrinsic_data[9] = {float(m_rot_radius), 0, float(RotationCamera::size().width/2),
                                            0, float(m_rot_radius), float(RotationCamera::size().height/2),
                                            0, 0, 1};
         cv::Mat virtual_intrinsic(3, 3, CV_32FC1, virtual_intrinsic_data);
-        const cv::Mat& virtual_intrinsic_inv = virtual_intrinsic.inv();
-        const cv::Mat& extrinsic_inv = m_extrinsic.inv();
-
-        // Cylindrical Projection
-        m_warp_mapx = cv::Mat(m_mapx.size(), CV_32FC1);
-        m_warp_mapy = cv::Mat(m_mapy.size(), CV_32FC1);
-        for(int j=0; j < m_mapx.cols; j++){
-            for(int i=0; i < m_mapx.rows; i++){
-                // To normalized coords
-                const cv::Vec3f& n_vec = cv::Mat( virtual_intrinsic_inv * extrinsic_inv * cv::Mat(cv::Vec3f(i,j,1)) ).at<cv::Vec3f>(0);
-                // Cylindrical coords
-                const cv::Vec3f cyl_vec(std::sin(n_vec[0]), n_vec[1], std::cos(n_vec[0]));
-                const cv::Vec3f& cyl_proj = cv::Mat( virtual_intrinsic * m_extrinsic * cv::Mat(cyl_vec) ).at<cv::Vec3f>(0);
-                cv::Vec2f c_cyl_proj = cv::Vec2f(cyl_proj[0]/cyl_proj[2], cyl_proj[1]/cyl_proj[2]);
-
-                if (c_cyl_proj[0] < 0 or c_cyl_proj[0] > m_dims.width)
-                    c_cyl_proj[0] = -1.0;
-                if (c_cyl_proj[1] < 0 or c_cyl_proj[1] > m_dims.height)
-                    c_cyl_proj[1] = -1.0;
-
-                m_warp_mapx.at<float>(i,j) = c_cyl_proj[0];
-                m_warp_mapy.at<float>(i,j) = c_cyl_proj[1];
-            }
-        }
+        cv::Mat extrinsic;
+        m_extrinsic.convertTo(extrinsic, CV_32FC1);
+
+        // Cylindrical Projection: the combined transformations are computed once for the whole image
+        const cv::Matx33f forward = cv::Mat(virtual_intrinsic * extrinsic);
+        const cv::Matx33f backward = cv::Mat(virtual_intrinsic.inv() * extrinsic.inv());
+
+        const cv::Mat intrinsic = m_intrinsic, dist_coeffs = m_dist_coeffs;
+        const cv::Size dims = m_dims;
+        this->reset_maps([intrinsic, dist_coeffs, dims, forward, backward](MapSet& _maps) {
+            cv::Mat undistort_mapx, undistort_mapy, warp_mapx, warp_mapy;
+            build_undistort_maps(intrinsic, dist_coeffs, dims, undistort_mapx, undistort_mapy);
+            math::build_cylindrical_maps(forward, backward, dims, warp_mapx, warp_mapy);
+
+            // Merge maps
+            _maps.mapx = undistort_mapx.clone();
+            _maps.mapy = undistort_mapy.clone();
+            cv::remap(undistort_mapx, _maps.mapx, warp_mapx, warp_mapy, cv::INTER_LINEAR, cv::BORDER_TRANSPARENT);
+            cv::remap(undistort_mapy, _maps.mapy, warp_mapx, warp_mapy, cv::INTER_LINEAR, cv::BORDER_TRANSPARENT);
+        });
+    }
 
-        // Merge maps
-        cv::remap(this->m_mapx, this->m_mapx, m_warp_mapx, m_warp_mapy, cv::INTER_LINEAR, cv::BORDER_TRANSPARENT);
-        cv::remap(this->m_mapy, this->m_mapy, m_warp_mapx, m_warp_mapy, cv::INTER_LINEAR, cv::BORDER_TRANSPARENT);
+    CylindricalCamera::CylindricalCamera(const RotationCamera& _cam, const CameraMaps& _maps) : RotationCamera(_cam)
+    {
+        this->set_maps(_maps);
     }
 } // namespace laz
\ No newline at end of file
@@ -60,10 +60,31 @@ namespace laz{
         return this->m_status;
     }
 
+    CameraFakeStream::CameraFakeStream(Camera const* _cam, const std::vector<std::string>& _img_paths,
+                                       const int& _prefetch_depth, const int& _nr_workers):
+            CameraStream(_cam), m_read_idx(0), m_img_paths(_img_paths),
+            m_prefetch_depth(_prefetch_depth), m_prefetch_idx(0), m_prefetch_workers(nullptr)
+    {
+        assert(m_prefetch_depth >= 0);
+        if (m_prefetch_depth > 0)
+            m_prefetch_workers = std::make_unique<ThreadPool>(_nr_workers);
+    }
+
+    CameraFakeStream::~CameraFakeStream()
+    {
+        this->clear_prefetch_ring();
+    }
+
+    void CameraFakeStream::reset()
+    {
+        m_read_idx = 0;
+        this->clear_prefetch_ring();
+    }
+
     StreamStatus CameraFakeStream::_connect()
     {
         this->m_status = StreamStatus::CONNECTED;
-        m_read_idx = 0;
+        this->reset();
         return this->m_status;
     }
 
@@ -71,17 +92,52 @@ namespace laz{
     {
 
         if (m_read_idx == this->stream_size() - 1) return cv::Mat();
-        cv::Mat remapped = this->read(m_read_idx);
+        if (m_prefetch_depth == 0)
+        {
+            cv::Mat remapped = this->read(m_read_idx);
+            m_read_idx++;
+            return remapped;
+        }
+
+        this->fill_prefetch_ring();
+        cv::Mat remapped = m_prefetch_ring.front().get();
+        m_prefetch_ring.pop_front();
         m_read_idx++;
+        // Keep the workers busy while the caller processes this frame
+        this->fill_prefetch_ring();
         return remapped;
     }
 
+    void CameraFakeStream::fill_prefetch_ring() const
+    {
+        // Same end of stream as read(): the last path is never streamed
+        while (static_cast<int>(m_prefetch_ring.size()) < m_prefetch_depth and m_prefetch_idx < this->stream_size() - 1)
+        {
+            const int idx = m_prefetch_idx++;
+            m_prefetch_ring.push_back(m_prefetch_workers->submit([this, idx]() { return this->read(idx); }));
+        }
+    }
+
+    void CameraFakeStream::clear_prefetch_ring() const
+    {
+        // Pending tasks reference this stream: wait for them before dropping their frames
+        for (std::future<cv::Mat>& frame : m_prefetch_ring)
+            frame.wait();
+        m_prefetch_ring.clear();
+        m_prefetch_idx = m_read_idx;
+    }
+
     cv::Mat CameraFakeStream::read(const int& idx) const
     {
         assert(idx < this->stream_size() - 1);
+        auto start = std::chrono::steady_clock::now();
         cv::Mat loaded_img = cv::imread(m_img_paths[idx], cv::IMREAD_COLOR);
+        m_decode_latency.record_since(start);
+
+        start = std::chrono::steady_clock::now();
         cv::Mat remapped_img;
         m_cam->remap(loaded_img, remapped_img, cv::INTER_LINEAR, cv::BORDER_REFLECT);
+        m_remap_latency.record_since(start);
         return remapped_img;
     }
 
@@ -4,62 +4,61 @@ namespace laz {
     // ----------------------------------------------------------------------------------------------
     // CvCylindricalCamera
     // ----------------------------------------------------------------------------------------------
-    CvCylindricalCamera::CvCylindricalCamera(const RotationCamera& _cam) : RotationCamera(_cam)
-    {
-        this->init_cylindrical_maps();
-    }
+    CvCylindricalCamera::CvCylindricalCamera(const RotationCamera& _cam) :
+            CvCylindricalCamera(_cam, cv::makePtr<cv::CylindricalWarper>())
+    {}
+
+    CvCylindricalCamera::CvCylindricalCamera(const RotationCamera& _cam, const CameraMaps& _maps) :
+            CvCylindricalCamera(_cam, cv::makePtr<cv::CylindricalWarper>(), _maps)
+    {}
 
-    void CvCylindricalCamera::init_cylindrical_maps()
+    CvCylindricalCamera::CvCylindricalCamera(const RotationCamera& _cam,
+                                             const cv::Ptr<cv::WarperCreator>& _warper_creator) :
+            RotationCamera(_cam), m_warper_creator(_warper_creator), m_corners(this->compute_corners())
     {
         cv::Mat extrinsic_32f, rotation_32f;
         m_rotation.convertTo(rotation_32f, CV_32FC1);
         m_extrinsic.convertTo(extrinsic_32f, CV_32FC1);
 
-        // Cylindrical Projection
-        cv::Ptr<cv::WarperCreator> warper_creator = this->create_cvwarper();
-        cv::Ptr<cv::detail::RotationWarper> warper = warper_creator->create(static_cast<float>(m_rot_radius));
-
-        warper->buildMaps(m_dims, extrinsic_32f, rotation_32f, m_warp_mapx, m_warp_mapy);
-        // Merge maps
-        cv::remap(this->m_mapx, this->m_mapx, m_warp_mapx, m_warp_mapy, cv::INTER_LINEAR, cv::BORDER_TRANSPARENT);
-        cv::remap(this->m_mapy, this->m_mapy, m_warp_mapx, m_warp_mapy, cv::INTER_LINEAR, cv::BORDER_TRANSPARENT);
-    }
+        const cv::Ptr<cv::detail::RotationWarper> warper = this->create_warper();
+        const cv::Mat intrinsic = m_intrinsic, dist_coeffs = m_dist_coeffs;
+        const cv::Size dims = m_dims;
+        this->reset_maps([intrinsic, dist_coeffs, dims, extrinsic_32f, rotation_32f, warper](MapSet& _maps) {
+            cv::Mat undistort_mapx, undistort_mapy, warp_mapx, warp_mapy;
+            build_undistort_maps(intrinsic, dist_coeffs, dims, undistort_mapx, undistort_mapy);
+            warper->buildMaps(dims, extrinsic_32f, rotation_32f, warp_mapx, warp_mapy);
 
-    cv::Rect CvCylindricalCamera::get_corners() const
-    {
-        cv::Mat extrinsic_32f, rotation_32f;
-        m_rotation.convertTo(rotation_32f, CV_32FC1);
-        m_extrinsic.convertTo(extrinsic_32f, CV_32FC1);
+            // Merge maps
+            _maps.mapx = undistort_mapx.clone();
+            _maps.mapy = undistort_mapy.clone();
+            cv::remap(undistort_mapx, _maps.mapx, warp_mapx, warp_mapy, cv::INTER_LINEAR, cv::BORDER_TRANSPARENT);
+            cv::remap(undistort_mapy, _maps.mapy, warp_mapx, warp_mapy, cv::INTER_LINEAR, cv::BORDER_TRANSPARENT);
 
-        // Cylindrical Projection
-        cv::Ptr<cv::WarperCreator> warper_creator = this->create_cvwarper();
-        cv::Ptr<cv::detail::RotationWarper> warper = warper_creator->create(static_cast<float>(m_rot_radius));
-        return warper->warpRoi(m_dims, extrinsic_32f, rotation_32f);
+            // The mask follows the projection only: undistortion keeps the whole image valid
+            cv::Mat full_mask(dims, CV_8UC1, cv::Scalar(255));
+            cv::remap(full_mask, _maps.mask, warp_mapx, warp_mapy, cv::INTER_NEAREST, cv::BORDER_CONSTANT, cv::Scalar(0));
+        });
     }
 
-    cv::Mat CvCylindricalCamera::get_mask() const
+    CvCylindricalCamera::CvCylindricalCamera(const RotationCamera& _cam,
+                                             const cv::Ptr<cv::WarperCreator>& _warper_creator,
+                                             const CameraMaps& _maps) :
+            RotationCamera(_cam), m_warper_creator(_warper_creator), m_corners(_maps.corners)
     {
-        // Create mask
-        cv::Mat mask(m_dims, CV_8UC1, cv::Scalar(255)), warped_mask;
-
-        cv::Mat extrinsic_32f, rotation_32f;
-        m_rotation.convertTo(rotation_32f, CV_32FC1);
-        m_extrinsic.convertTo(extrinsic_32f, CV_32FC1);
-
-        // Merge maps
-        cv::Mat maskmapx, maskmapy;
-        cv::remap(mask, warped_mask, m_warp_mapx, m_warp_mapy, cv::INTER_NEAREST, cv::BORDER_CONSTANT, cv::Scalar(0));
-        return warped_mask;
+        this->set_maps(_maps);
     }
 
-    cv::Ptr<cv::WarperCreator> CvCylindricalCamera::create_cvwarper() const
+    cv::Ptr<cv::detail::RotationWarper> CvCylindricalCamera::create_warper() const
     {
-        return cv::makePtr<cv::CylindricalWarper>();
+        return m_warper_creator->create(static_cast<float>(m_rot_radius));
     }
 
-    cv::Ptr<cv::WarperCreator> CvSphericalCamera::create_cvwarper() const
+    cv::Rect CvCylindricalCamera::compute_corners() const
     {
-        return cv::makePtr<cv::SphericalWarper>();
+        cv::Mat extrinsic_32f, rotation_32f;
+        m_rotation.convertTo(rotation_32f, CV_32FC1);
+        m_extrinsic.convertTo(extrinsic_32f, CV_32FC1);
+        return this->create_warper()->warpRoi(m_dims, extrinsic_32f, rotation_32f);
     }
 
-} // namespace laz
\ No newline at end of file
+} // namespace laz
@@ -0,0 +1,159 @@
+#include "core/framepool.h"
+#include <new>
+#include <assert.h>
+
+namespace laz {
+
+    FramePoolAllocator::FramePoolAllocator(const size_t& _max_pooled_bytes) :
+            m_max_pooled_bytes(_max_pooled_bytes),
+            m_pooled_bytes(0),
+            m_nr_allocations(0),
+            m_nr_reuses(0)
+    {}
+
+    FramePoolAllocator::~FramePoolAllocator()
+    {
+        this->clear();
+    }
+
+    cv::UMatData* FramePoolAllocator::allocate(int _dims, const int* _sizes, int _type, void* _data, size_t* _step,
+                                               cv::AccessFlag _flags, cv::UMatUsageFlags _usage_flags) const
+    {
+        // Same layout as the standard allocator: continuous rows
+        size_t total = CV_ELEM_SIZE(_type);
+        for (int i = _dims - 1; i >= 0; i--)
+        {
+            if (_step)
+            {
+                if (_data && _step[i] != CV_AUTOSTEP)
+                {
+                    CV_Assert(total <= _step[i]);
+                    total = _step[i];
+                }
+                else
+                    _step[i] = total;
+            }
+            total *= _sizes[i];
+        }
+
+        cv::UMatData* u = nullptr;
+        if (_data)
+        {
+            // Wrapping of external data, e.g. by Mat::getUMat(): only the bookkeeping is recycled
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                if (!m_free_headers.empty())
+                {
+                    u = m_free_headers.back();
+                    m_free_headers.pop_back();
+                }
+            }
+            if (u)
+                m_nr_reuses++;
+            else
+            {
+                u = new cv::UMatData(this);
+                m_nr_allocations++;
+            }
+            u->data = u->origdata = static_cast<uchar*>(_data);
+            u->size = total;
+            u->flags |= cv::UMatData::USER_ALLOCATED;
+            return u;
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            auto it = m_free_buffers.find(total);
+            if (it != m_free_buffers.end() && !it->second.empty())
+            {
+                u = it->second.back();
+                it->second.pop_back();
+                m_pooled_bytes -= total;
+            }
+        }
+
+        if (u)
+        {
+            // Recycle both the buffer and its bookkeeping: no heap allocation at all
+            uchar* data = u->origdata;
+            u->~UMatData();
+            new (u) cv::UMatData(this);
+            u->data = u->origdata = data;
+            u->size = total;
+            m_nr_reuses++;
+            return u;
+        }
+
+        u = new cv::UMatData(this);
+        u->data = u->origdata = static_cast<uchar*>(cv::fastMalloc(total));
+        u->size = total;
+        m_nr_allocations++;
+        return u;
+    }
+
+    bool FramePoolAllocator::allocate(cv::UMatData* _u, cv::AccessFlag _access_flags,
+                                      cv::UMatUsageFlags _usage_flags) const
+    {
+        return _u != nullptr;
+    }
+
+    void FramePoolAllocator::deallocate(cv::UMatData* _u) const
+    {
+        if (!_u)
+            return;
+        CV_Assert(_u->urefcount == 0);
+        CV_Assert(_u->refcount == 0);
+
+        if (_u->flags & cv::UMatData::USER_ALLOCATED)
+        {
+            // Same as delete: the destructor releases the Mat wrapped by Mat::getUMat(), outside of the lock since
+            // that Mat may come back to this allocator
+            _u->~UMatData();
+            new (_u) cv::UMatData(this);
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_free_headers.push_back(_u);
+            return;
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (m_pooled_bytes + _u->size <= m_max_pooled_bytes)
+            {
+                m_free_buffers[_u->size].push_back(_u);
+                m_pooled_bytes += _u->size;
+                return;
+            }
+        }
+
+        cv::fastFree(_u->origdata);
+        _u->origdata = nullptr;
+        delete _u;
+    }
+
+    void FramePoolAllocator::clear()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        for (auto& free_buffers : m_free_buffers)
+        {
+            for (cv::UMatData* u : free_buffers.second)
+            {
+                cv::fastFree(u->origdata);
+                u->origdata = nullptr;
+                delete u;
+            }
+        }
+        m_free_buffers.clear();
+        m_pooled_bytes = 0;
+
+        for (cv::UMatData* u : m_free_headers)
+            delete u;
+        m_free_headers.clear();
+    }
+
+    size_t FramePoolAllocator::get_pooled_bytes() const
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_pooled_bytes;
+    }
+
+} // namespace laz
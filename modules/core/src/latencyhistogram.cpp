@@ -0,0 +1,105 @@
+#include "core/latencyhistogram.h"
+#include <cmath>
+#include <algorithm>
+
+namespace laz {
+
+    nlohmann::json LatencySummary::to_json() const
+    {
+        return nlohmann::json{{"count", count}, {"mean_ms", mean_ms}, {"p50_ms", p50_ms}, {"p99_ms", p99_ms},
+                              {"max_ms", max_ms}};
+    }
+
+    LatencyHistogram::LatencyHistogram()
+    {
+        this->reset();
+    }
+
+    int LatencyHistogram::bucket_index(const uint64_t& _us)
+    {
+        if (_us < SUB_BUCKETS)
+            return static_cast<int>(_us);
+        // Highest set bit gives the power of two, the next SUB_BUCKET_BITS bits the position within it
+        const int exponent = 63 - __builtin_clzll(_us);
+        const int sub_bucket = static_cast<int>((_us >> (exponent - SUB_BUCKET_BITS)) & (SUB_BUCKETS - 1));
+        return SUB_BUCKETS + (exponent - SUB_BUCKET_BITS) * SUB_BUCKETS + sub_bucket;
+    }
+
+    uint64_t LatencyHistogram::bucket_value(const int& _idx)
+    {
+        if (_idx < SUB_BUCKETS)
+            return _idx;
+        // Middle of the bucket
+        const int exponent = (_idx - SUB_BUCKETS) / SUB_BUCKETS + SUB_BUCKET_BITS;
+        const uint64_t sub_bucket = (_idx - SUB_BUCKETS) % SUB_BUCKETS;
+        const uint64_t width = uint64_t(1) << (exponent - SUB_BUCKET_BITS);
+        return (uint64_t(SUB_BUCKETS) + sub_bucket) * width + width / 2;
+    }
+
+    void LatencyHistogram::record(const double& _ms)
+    {
+        const uint64_t us = static_cast<uint64_t>(std::llround(std::max(0., _ms) * 1000.));
+        m_buckets[bucket_index(us)].fetch_add(1, std::memory_order_relaxed);
+        m_count.fetch_add(1, std::memory_order_relaxed);
+        m_sum_us.fetch_add(us, std::memory_order_relaxed);
+        uint64_t max_us = m_max_us.load(std::memory_order_relaxed);
+        while (us > max_us && !m_max_us.compare_exchange_weak(max_us, us, std::memory_order_relaxed));
+    }
+
+    double LatencyHistogram::record_since(const std::chrono::steady_clock::time_point& _start)
+    {
+        const std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - _start;
+        this->record(elapsed.count());
+        return elapsed.count();
+    }
+
+    LatencySummary LatencyHistogram::summary() const
+    {
+        LatencySummary summary;
+        std::array<uint64_t, NR_BUCKETS> buckets;
+        uint64_t count = 0;
+        for (int i = 0; i < NR_BUCKETS; i++)
+        {
+            buckets[i] = m_buckets[i].load(std::memory_order_relaxed);
+            count += buckets[i];
+        }
+        if (count == 0)
+            return summary;
+
+        const uint64_t max_us = m_max_us.load(std::memory_order_relaxed);
+        summary.count = count;
+        summary.mean_ms = m_sum_us.load(std::memory_order_relaxed) / 1000. / m_count.load(std::memory_order_relaxed);
+        summary.max_ms = max_us / 1000.;
+
+        // Nearest rank percentiles, clamped to the exact maximum
+        const uint64_t p50_rank = (count * 50 + 99) / 100;
+        const uint64_t p99_rank = (count * 99 + 99) / 100;
+        uint64_t cumulated = 0;
+        bool p50_found = false;
+        for (int i = 0; i < NR_BUCKETS; i++)
+        {
+            cumulated += buckets[i];
+            if (!p50_found && cumulated >= p50_rank)
+            {
+                summary.p50_ms = std::min(bucket_value(i), max_us) / 1000.;
+                p50_found = true;
+            }
+            if (cumulated >= p99_rank)
+            {
+                summary.p99_ms = std::min(bucket_value(i), max_us) / 1000.;
+                break;
+            }
+        }
+        return summary;
+    }
+
+    void LatencyHistogram::reset()
+    {
+        for (auto& bucket : m_buckets)
+            bucket.store(0, std::memory_order_relaxed);
+        m_count.store(0, std::memory_order_relaxed);
+        m_sum_us.store(0, std::memory_order_relaxed);
+        m_max_us.store(0, std::memory_order_relaxed);
+    }
+
+} // namespace laz
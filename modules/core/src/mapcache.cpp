@@ -0,0 +1,245 @@
+#include "core/mapcache.h"
+#include <stdexcept>
+#include <memory>
+#include <cstring>
+#include <cerrno>
+#include <cstdio>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <assert.h>
+
+#include <plog/Log.h>
+
+namespace laz {
+
+    static const uint32_t MAP_CACHE_MAGIC = 0x4c415a4d; // "LAZM"
+    // Bump whenever the maps built for a camera type change, since keys only hash the calibration and the type.
+    // 2: CvSphericalCamera builds spherical instead of cylindrical maps
+    static const uint32_t MAP_CACHE_VERSION = 2;
+    static const size_t MAP_CACHE_ALIGN = 64;
+
+    /**
+     * Layout of a cache file: this header, then the mapx, mapy and mask rows, each block aligned.
+     */
+    struct MapCacheHeader {
+        uint32_t magic;
+        uint32_t version;
+        int32_t map_rows, map_cols;
+        int32_t mask_rows, mask_cols;
+        int32_t corners[4];             // x, y, width, height
+        uint64_t mapx_offset;
+        uint64_t mapy_offset;
+        uint64_t mask_offset;
+        uint64_t file_size;
+    };
+
+    static size_t align_up(const size_t& _value)
+    {
+        return (_value + MAP_CACHE_ALIGN - 1) / MAP_CACHE_ALIGN * MAP_CACHE_ALIGN;
+    }
+
+    /**
+     * Read-only file mapping, unmapped with its last reference.
+     */
+    class MappedFile {
+    public:
+        MappedFile(void* _data, const size_t& _size) : data(static_cast<uchar*>(_data)), size(_size) {}
+        ~MappedFile() { munmap(data, size); }
+
+        uchar* const data;
+        const size_t size;
+    };
+
+    /**
+     * Allocator of the Mats viewing a MappedFile: each Mat buffer holds a reference to the mapping.
+     */
+    class MappedFileAllocator : public cv::MatAllocator {
+    public:
+        cv::UMatData* allocate(int _dims, const int* _sizes, int _type, void* _data, size_t* _step,
+                               cv::AccessFlag _flags, cv::UMatUsageFlags _usage_flags) const override
+        {
+            // Only reached when a Mat of the mapping is reallocated: use regular buffers
+            return cv::Mat::getStdAllocator()->allocate(_dims, _sizes, _type, _data, _step, _flags, _usage_flags);
+        }
+
+        bool allocate(cv::UMatData* _u, cv::AccessFlag _access_flags, cv::UMatUsageFlags _usage_flags) const override
+        {
+            return _u != nullptr;
+        }
+
+        void deallocate(cv::UMatData* _u) const override
+        {
+            if (!_u)
+                return;
+            CV_Assert(_u->urefcount == 0);
+            CV_Assert(_u->refcount == 0);
+            delete static_cast<std::shared_ptr<const MappedFile>*>(_u->userdata);
+            _u->userdata = nullptr;
+            _u->origdata = nullptr;
+            delete _u;
+        }
+
+        cv::Mat view(const std::shared_ptr<const MappedFile>& _file, const size_t& _offset,
+                     const int& _rows, const int& _cols, const int& _type) const
+        {
+            cv::Mat mat(_rows, _cols, _type, _file->data + _offset);
+            cv::UMatData* u = new cv::UMatData(this);
+            u->data = u->origdata = mat.data;
+            u->size = mat.total() * mat.elemSize();
+            u->userdata = new std::shared_ptr<const MappedFile>(_file);
+            u->refcount = 1;
+            mat.u = u;
+            return mat;
+        }
+    };
+
+    static const MappedFileAllocator& get_mapped_file_allocator()
+    {
+        // Never destroyed: cached maps may be released during static destruction
+        static const MappedFileAllocator* allocator = new MappedFileAllocator();
+        return *allocator;
+    }
+
+    static void write_rows(std::ofstream& _file, const cv::Mat& _mat, const uint64_t& _offset)
+    {
+        _file.seekp(_offset);
+        for (int y = 0; y < _mat.rows; y++)
+            _file.write(reinterpret_cast<const char*>(_mat.ptr(y)), _mat.cols * _mat.elemSize());
+    }
+
+    MapCache::MapCache(const std::string& _cache_dir) : m_cache_dir(_cache_dir)
+    {
+        if (mkdir(m_cache_dir.c_str(), 0755) != 0 && errno != EEXIST)
+        {
+            std::string msg = "Error: could not create map cache directory '" + m_cache_dir + "': " +
+                              std::strerror(errno) + "\n";
+            PLOGE << msg;
+            throw std::runtime_error(msg);
+        }
+    }
+
+    std::string MapCache::make_key(const std::string& _parameters, const std::string& _warper)
+    {
+        // FNV-1a over the parameters, the warper and the cache version
+        uint64_t hash = 0xcbf29ce484222325ull;
+        auto hash_bytes = [&hash](const char* _data, const size_t& _size) {
+            for (size_t i = 0; i < _size; i++)
+            {
+                hash ^= static_cast<uchar>(_data[i]);
+                hash *= 0x100000001b3ull;
+            }
+        };
+        hash_bytes(_parameters.data(), _parameters.size() + 1);
+        hash_bytes(_warper.data(), _warper.size() + 1);
+        hash_bytes(reinterpret_cast<const char*>(&MAP_CACHE_VERSION), sizeof(MAP_CACHE_VERSION));
+
+        std::ostringstream key;
+        key << std::hex << std::setw(16) << std::setfill('0') << hash;
+        return key.str();
+    }
+
+    std::string MapCache::get_path(const std::string& _key) const
+    {
+        return m_cache_dir + "/" + _key + ".maps";
+    }
+
+    bool MapCache::load(const std::string& _key, CameraMaps& _maps) const
+    {
+        const std::string path = this->get_path(_key);
+        const int fd = open(path.c_str(), O_RDONLY);
+        if (fd < 0)
+            return false;
+
+        struct stat file_stat;
+        if (fstat(fd, &file_stat) != 0 || file_stat.st_size < static_cast<off_t>(sizeof(MapCacheHeader)))
+        {
+            close(fd);
+            PLOGW << "Ignoring truncated map cache file '" << path << "'.";
+            return false;
+        }
+
+        // Private mapping: pages written by a Mat holder are copied, the file is never modified
+        void* data = mmap(nullptr, file_stat.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+        close(fd);
+        if (data == MAP_FAILED)
+        {
+            PLOGW << "Could not map '" << path << "': " << std::strerror(errno);
+            return false;
+        }
+        auto file = std::make_shared<const MappedFile>(data, file_stat.st_size);
+
+        const auto* header = reinterpret_cast<const MapCacheHeader*>(file->data);
+        const size_t map_bytes = size_t(header->map_rows) * header->map_cols * sizeof(float);
+        const size_t mask_bytes = size_t(header->mask_rows) * header->mask_cols;
+        if (header->magic != MAP_CACHE_MAGIC || header->version != MAP_CACHE_VERSION ||
+            header->file_size != file->size ||
+            header->mapx_offset + map_bytes > file->size ||
+            header->mapy_offset + map_bytes > file->size ||
+            header->mask_offset + mask_bytes > file->size)
+        {
+            PLOGW << "Ignoring invalid map cache file '" << path << "'.";
+            return false;
+        }
+
+        const MappedFileAllocator& allocator = get_mapped_file_allocator();
+        _maps.mapx = allocator.view(file, header->mapx_offset, header->map_rows, header->map_cols, CV_32FC1);
+        _maps.mapy = allocator.view(file, header->mapy_offset, header->map_rows, header->map_cols, CV_32FC1);
+        _maps.mask = allocator.view(file, header->mask_offset, header->mask_rows, header->mask_cols, CV_8UC1);
+        _maps.corners = cv::Rect(header->corners[0], header->corners[1], header->corners[2], header->corners[3]);
+        return true;
+    }
+
+    void MapCache::store(const std::string& _key, const CameraMaps& _maps) const
+    {
+        assert(_maps.mapx.type() == CV_32FC1 && _maps.mapy.type() == CV_32FC1);
+        assert(_maps.mapx.size() == _maps.mapy.size());
+        assert(_maps.mask.type() == CV_8UC1);
+
+        MapCacheHeader header{};
+        header.magic = MAP_CACHE_MAGIC;
+        header.version = MAP_CACHE_VERSION;
+        header.map_rows = _maps.mapx.rows;
+        header.map_cols = _maps.mapx.cols;
+        header.mask_rows = _maps.mask.rows;
+        header.mask_cols = _maps.mask.cols;
+        header.corners[0] = _maps.corners.x;
+        header.corners[1] = _maps.corners.y;
+        header.corners[2] = _maps.corners.width;
+        header.corners[3] = _maps.corners.height;
+        const size_t map_bytes = _maps.mapx.total() * _maps.mapx.elemSize();
+        header.mapx_offset = align_up(sizeof(MapCacheHeader));
+        header.mapy_offset = header.mapx_offset + align_up(map_bytes);
+        header.mask_offset = header.mapy_offset + align_up(map_bytes);
+        header.file_size = header.mask_offset + _maps.mask.total();
+
+        const std::string path = this->get_path(_key);
+        const std::string tmp_path = path + ".tmp" + std::to_string(getpid());
+        {
+            std::ofstream file(tmp_path, std::ios::binary | std::ios::trunc);
+            file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+            write_rows(file, _maps.mapx, header.mapx_offset);
+            write_rows(file, _maps.mapy, header.mapy_offset);
+            write_rows(file, _maps.mask, header.mask_offset);
+            if (!file)
+            {
+                std::remove(tmp_path.c_str());
+                std::string msg = "Error: could not write map cache file '" + tmp_path + "'.\n";
+                PLOGE << msg;
+                throw std::runtime_error(msg);
+            }
+        }
+        if (std::rename(tmp_path.c_str(), path.c_str()) != 0)
+        {
+            std::remove(tmp_path.c_str());
+            std::string msg = "Error: could not write map cache file '" + path + "': " + std::strerror(errno) + "\n";
+            PLOGE << msg;
+            throw std::runtime_error(msg);
+        }
+    }
+
+} // namespace laz
@@ -1,4 +1,8 @@
 #include "core/math.h"
+#include <cmath>
+#include <vector>
+#include <opencv2/core/utility.hpp>
+#include <opencv2/core/hal/intrin.hpp>
 
 namespace math{
     void homogenous_to_cartesian(cv::InputArray _src, cv::OutputArray _dst)
@@ -36,5 +40,83 @@ namespace math{
         cv::minMaxLoc(cartesian_vectors.row(1), &ymin, &ymax, nullptr, nullptr);
         return cv::Rect(xmin,ymin,xmax-xmin,ymax-ymin);
     }
+
+    void build_cylindrical_maps(const cv::Matx33f& _forward, const cv::Matx33f& _backward, const cv::Size& _dims,
+                                cv::OutputArray _mapx, cv::OutputArray _mapy)
+    {
+        _mapx.create(_dims, CV_32FC1);
+        _mapy.create(_dims, CV_32FC1);
+        cv::Mat mapx = _mapx.getMat(), mapy = _mapy.getMat();
+
+        const cv::Matx33f& fwd = _forward;
+        const cv::Matx33f& bwd = _backward;
+        const float width = static_cast<float>(_dims.width);
+        const float height = static_cast<float>(_dims.height);
+
+        cv::parallel_for_(cv::Range(0, _dims.height), [&](const cv::Range& range) {
+            std::vector<float> sin_row(_dims.width), cos_row(_dims.width), n1_row(_dims.width);
+
+            for (int i = range.start; i < range.end; i++)
+            {
+                float* mapx_row = mapx.ptr<float>(i);
+                float* mapy_row = mapy.ptr<float>(i);
+
+                // For a given row, n = bwd * (i, j, 1) is affine in j
+                const float n0_base = bwd(0, 0) * i + bwd(0, 2);
+                const float n1_base = bwd(1, 0) * i + bwd(1, 2);
+                for (int j = 0; j < _dims.width; j++)
+                {
+                    const float n0 = n0_base + bwd(0, 1) * j;
+                    n1_row[j] = n1_base + bwd(1, 1) * j;
+                    sin_row[j] = std::sin(n0);
+                    cos_row[j] = std::cos(n0);
+                }
+
+                int j = 0;
+#if CV_SIMD
+                const int nlanes = cv::v_float32::nlanes;
+                const cv::v_float32 v_f00 = cv::vx_setall_f32(fwd(0, 0)), v_f01 = cv::vx_setall_f32(fwd(0, 1)),
+                                    v_f02 = cv::vx_setall_f32(fwd(0, 2)), v_f10 = cv::vx_setall_f32(fwd(1, 0)),
+                                    v_f11 = cv::vx_setall_f32(fwd(1, 1)), v_f12 = cv::vx_setall_f32(fwd(1, 2)),
+                                    v_f20 = cv::vx_setall_f32(fwd(2, 0)), v_f21 = cv::vx_setall_f32(fwd(2, 1)),
+                                    v_f22 = cv::vx_setall_f32(fwd(2, 2));
+                const cv::v_float32 v_zero = cv::vx_setzero_f32(), v_invalid = cv::vx_setall_f32(-1.f);
+                const cv::v_float32 v_width = cv::vx_setall_f32(width), v_height = cv::vx_setall_f32(height);
+                for (; j <= _dims.width - nlanes; j += nlanes)
+                {
+                    const cv::v_float32 v_sin = cv::vx_load(&sin_row[j]);
+                    const cv::v_float32 v_n1 = cv::vx_load(&n1_row[j]);
+                    const cv::v_float32 v_cos = cv::vx_load(&cos_row[j]);
+
+                    // Cylindrical coords projected back on the image plane
+                    const cv::v_float32 v_q0 = cv::v_muladd(v_f00, v_sin, cv::v_muladd(v_f01, v_n1, v_f02 * v_cos));
+                    const cv::v_float32 v_q1 = cv::v_muladd(v_f10, v_sin, cv::v_muladd(v_f11, v_n1, v_f12 * v_cos));
+                    const cv::v_float32 v_q2 = cv::v_muladd(v_f20, v_sin, cv::v_muladd(v_f21, v_n1, v_f22 * v_cos));
+                    cv::v_float32 v_x = v_q0 / v_q2;
+                    cv::v_float32 v_y = v_q1 / v_q2;
+
+                    v_x = cv::v_select((v_x < v_zero) | (v_x > v_width), v_invalid, v_x);
+                    v_y = cv::v_select((v_y < v_zero) | (v_y > v_height), v_invalid, v_y);
+                    cv::v_store(mapx_row + j, v_x);
+                    cv::v_store(mapy_row + j, v_y);
+                }
+#endif
+                for (; j < _dims.width; j++)
+                {
+                    const float q0 = fwd(0, 0) * sin_row[j] + fwd(0, 1) * n1_row[j] + fwd(0, 2) * cos_row[j];
+                    const float q1 = fwd(1, 0) * sin_row[j] + fwd(1, 1) * n1_row[j] + fwd(1, 2) * cos_row[j];
+                    const float q2 = fwd(2, 0) * sin_row[j] + fwd(2, 1) * n1_row[j] + fwd(2, 2) * cos_row[j];
+                    float x = q0 / q2, y = q1 / q2;
+
+                    if (x < 0 or x > width)
+                        x = -1.0;
+                    if (y < 0 or y > height)
+                        y = -1.0;
+                    mapx_row[j] = x;
+                    mapy_row[j] = y;
+                }
+            }
+        });
+    }
 } // namespace math
 
@@ -0,0 +1,225 @@
+#include "core/shmring.h"
+#include <stdexcept>
+#include <chrono>
+#include <thread>
+#include <cstring>
+#include <cerrno>
+#include <new>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <assert.h>
+
+#include <plog/Log.h>
+
+namespace laz {
+
+    static const uint32_t SHM_RING_MAGIC = 0x4c415a52; // "LAZR"
+    static const uint32_t SHM_RING_VERSION = 1;
+    static const size_t SHM_RING_ALIGN = 64;
+
+    static size_t align_up(const size_t& _value)
+    {
+        return (_value + SHM_RING_ALIGN - 1) / SHM_RING_ALIGN * SHM_RING_ALIGN;
+    }
+
+    static int64_t now_us()
+    {
+        return std::chrono::duration_cast<std::chrono::microseconds>(
+                std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    static void throw_errno(const std::string& _what, const std::string& _name)
+    {
+        std::string msg = "Error: " + _what + " shared memory '" + _name + "': " + std::strerror(errno) + "\n";
+        PLOGE << msg;
+        throw std::runtime_error(msg);
+    }
+
+    ShmRingWriter::ShmRingWriter(const std::string& _name, const int& _nr_slots, const size_t& _slot_capacity) :
+            m_name(_name),
+            m_header(nullptr),
+            m_next_seq(1),
+            m_writing(false)
+    {
+        assert(_nr_slots > 0);
+        assert(_slot_capacity > 0);
+
+        const size_t slot_stride = align_up(sizeof(ShmSlotHeader)) + align_up(_slot_capacity);
+        m_mapped_size = align_up(sizeof(ShmRingHeader)) + _nr_slots * slot_stride;
+
+        // Start from a fresh object: readers of a previous ring keep their own mapping
+        shm_unlink(m_name.c_str());
+        const int fd = shm_open(m_name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0644);
+        if (fd < 0)
+            throw_errno("could not create", m_name);
+        if (ftruncate(fd, m_mapped_size) != 0){
+            close(fd);
+            shm_unlink(m_name.c_str());
+            throw_errno("could not size", m_name);
+        }
+        void* mapped = mmap(nullptr, m_mapped_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        close(fd);
+        if (mapped == MAP_FAILED){
+            shm_unlink(m_name.c_str());
+            throw_errno("could not map", m_name);
+        }
+
+        // ftruncate zero-fills: every slot starts empty (seq 0)
+        m_header = new (mapped) ShmRingHeader();
+        m_header->nr_slots = _nr_slots;
+        m_header->slot_capacity = align_up(_slot_capacity);
+        m_header->slot_stride = slot_stride;
+        m_header->write_seq.store(0);
+        for (int i = 0; i < _nr_slots; i++)
+            new (get_slot(i + 1)) ShmSlotHeader();
+        m_header->version = SHM_RING_VERSION;
+        // Readers check the magic last
+        std::atomic_thread_fence(std::memory_order_release);
+        m_header->magic = SHM_RING_MAGIC;
+
+        PLOGI << "Shared memory ring '" << m_name << "': " << _nr_slots << " slots of " << _slot_capacity << " bytes.";
+    }
+
+    ShmRingWriter::~ShmRingWriter()
+    {
+        munmap(m_header, m_mapped_size);
+        shm_unlink(m_name.c_str());
+    }
+
+    ShmSlotHeader* ShmRingWriter::get_slot(const uint64_t& _seq) const
+    {
+        char* base = reinterpret_cast<char*>(m_header) + align_up(sizeof(ShmRingHeader));
+        return reinterpret_cast<ShmSlotHeader*>(base + ((_seq - 1) % m_header->nr_slots) * m_header->slot_stride);
+    }
+
+    cv::Mat ShmRingWriter::begin_write(const cv::Size& _size, const int& _type)
+    {
+        const size_t step = _size.width * CV_ELEM_SIZE(_type);
+        if (step * _size.height > m_header->slot_capacity){
+            std::string msg = "Error: mosaic of " + std::to_string(step * _size.height) +
+                              " bytes does not fit the shared memory slots of '" + m_name + "'\n";
+            PLOGE << msg;
+            throw std::runtime_error(msg);
+        }
+
+        ShmSlotHeader* slot = get_slot(m_next_seq);
+        if (!m_writing)
+        {
+            // Mark the slot busy before touching the pixels: readers of the previous frame see it invalidated
+            slot->seq.store(0, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_release);
+            m_writing = true;
+        }
+        slot->rows = _size.height;
+        slot->cols = _size.width;
+        slot->type = _type;
+        slot->step = step;
+
+        char* data = reinterpret_cast<char*>(slot) + align_up(sizeof(ShmSlotHeader));
+        return cv::Mat(_size, _type, data, step);
+    }
+
+    uint64_t ShmRingWriter::commit()
+    {
+        assert(m_writing);
+        ShmSlotHeader* slot = get_slot(m_next_seq);
+        slot->timestamp_us = now_us();
+        slot->seq.store(m_next_seq, std::memory_order_release);
+        m_header->write_seq.store(m_next_seq, std::memory_order_release);
+        m_writing = false;
+        return m_next_seq++;
+    }
+
+    ShmRingReader::ShmRingReader(const std::string& _name) :
+            m_name(_name),
+            m_header(nullptr),
+            m_last_seq(0),
+            m_nr_dropped(0)
+    {
+        const int fd = shm_open(m_name.c_str(), O_RDONLY, 0);
+        if (fd < 0)
+            throw_errno("could not open", m_name);
+        struct stat file_stat;
+        if (fstat(fd, &file_stat) != 0){
+            close(fd);
+            throw_errno("could not stat", m_name);
+        }
+        m_mapped_size = file_stat.st_size;
+        void* mapped = mmap(nullptr, m_mapped_size, PROT_READ, MAP_SHARED, fd, 0);
+        close(fd);
+        if (mapped == MAP_FAILED)
+            throw_errno("could not map", m_name);
+
+        m_header = reinterpret_cast<const ShmRingHeader*>(mapped);
+        if (m_mapped_size < sizeof(ShmRingHeader) || m_header->magic != SHM_RING_MAGIC ||
+            m_header->version != SHM_RING_VERSION){
+            munmap(mapped, m_mapped_size);
+            std::string msg = "Error: '" + m_name + "' is not a mosaic ring.\n";
+            PLOGE << msg;
+            throw std::runtime_error(msg);
+        }
+        std::atomic_thread_fence(std::memory_order_acquire);
+        // Only the frames published from now on are read
+        m_last_seq = m_header->write_seq.load(std::memory_order_acquire);
+    }
+
+    ShmRingReader::~ShmRingReader()
+    {
+        munmap(const_cast<ShmRingHeader*>(m_header), m_mapped_size);
+    }
+
+    const ShmSlotHeader* ShmRingReader::get_slot(const uint64_t& _seq) const
+    {
+        const char* base = reinterpret_cast<const char*>(m_header) + align_up(sizeof(ShmRingHeader));
+        return reinterpret_cast<const ShmSlotHeader*>(base + ((_seq - 1) % m_header->nr_slots) * m_header->slot_stride);
+    }
+
+    bool ShmRingReader::read(ShmFrame& _frame, const int& _timeout_ms)
+    {
+        // No cross-process notification: poll the published sequence number
+        const auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(_timeout_ms);
+        while (true)
+        {
+            const uint64_t write_seq = m_header->write_seq.load(std::memory_order_acquire);
+            if (write_seq > m_last_seq)
+            {
+                uint64_t seq = m_last_seq + 1;
+                // The slot of the oldest frame may be under rewrite: keep one slot of margin
+                const uint64_t nr_slots = m_header->nr_slots;
+                if (write_seq - m_last_seq >= nr_slots)
+                    seq = nr_slots > 1 ? write_seq - nr_slots + 2 : write_seq;
+
+                const ShmSlotHeader* slot = get_slot(seq);
+                if (slot->seq.load(std::memory_order_acquire) == seq)
+                {
+                    _frame.seq = seq;
+                    _frame.timestamp_us = slot->timestamp_us;
+                    const char* data = reinterpret_cast<const char*>(slot) + align_up(sizeof(ShmSlotHeader));
+                    _frame.image = cv::Mat(slot->rows, slot->cols, slot->type, const_cast<char*>(data), slot->step);
+                    if (is_valid(_frame))
+                    {
+                        m_nr_dropped += seq - m_last_seq - 1;
+                        m_last_seq = seq;
+                        return true;
+                    }
+                }
+                // Overwritten meanwhile: catch up with the producer
+                m_nr_dropped += seq - m_last_seq;
+                m_last_seq = seq;
+                continue;
+            }
+            if (_timeout_ms >= 0 && std::chrono::steady_clock::now() >= deadline)
+                return false;
+            std::this_thread::sleep_for(std::chrono::microseconds(200));
+        }
+    }
+
+    bool ShmRingReader::is_valid(const ShmFrame& _frame) const
+    {
+        std::atomic_thread_fence(std::memory_order_acquire);
+        return get_slot(_frame.seq)->seq.load(std::memory_order_relaxed) == _frame.seq;
+    }
+
+} // namespace laz
@@ -5,8 +5,12 @@ namespace laz {
     // ----------------------------------------------------------------------------------------------
     // StreamBundler
     // ----------------------------------------------------------------------------------------------
-    StreamBundler::StreamBundler(const std::vector<CameraStream*>& _streams) : m_streams(_streams)
+    StreamBundler::StreamBundler(const std::vector<CameraStream*>& _streams, const int& _nr_workers) :
+            m_streams(_streams), m_read_latencies(_streams.size(), 0.),
+            m_read_histograms(_streams.size()), m_read_workers(nullptr)
     {
+        if (_nr_workers > 0)
+            m_read_workers = std::make_unique<ThreadPool>(_nr_workers);
         this->init_cache();
     }
 
@@ -17,9 +21,19 @@ namespace laz {
 
     void StreamBundler::init_cache() const
     {
-        get_mask_bundle();
-        get_corners_bundle();
-        get_size_bundle();
+        if (!m_cache.empty())
+            return;
+
+        std::vector<cv::Mat> mask_bundle(m_streams.size());
+        std::vector<cv::Rect> corners_bundle(m_streams.size());
+        std::vector<cv::Size> size_bundle(m_streams.size());
+        for (int i=0; i<m_streams.size(); i++)
+        {
+            mask_bundle[i] = m_streams.at(i)->get_mask();
+            corners_bundle[i] = m_streams.at(i)->get_corners();
+            size_bundle[i] = m_streams.at(i)->size();
+        }
+        m_cache.geometry = std::make_shared<const BundleGeometry>(mask_bundle, corners_bundle, size_bundle);
     }
 
     void StreamBundler::reset()
@@ -29,12 +43,18 @@ namespace laz {
     }
 
     std::vector<cv::Mat> StreamBundler::read() const {
-        std::vector<cv::Mat> img_bundle(m_streams.size());
+        std::vector<cv::Mat> img_bundle;
+        this->read(img_bundle);
+        return img_bundle;
+    }
+
+    void StreamBundler::read(std::vector<cv::Mat>& _img_bundle) const {
+        _img_bundle.assign(m_streams.size(), cv::Mat());
 
         if (this->get_status() != StreamStatus::CONNECTED)
         {
             PLOGW << "Tried to read from unconnected bundle. Abort.";
-            return img_bundle;
+            return;
         }
 
         for (int i=0; i<m_streams.size(); i++)
@@ -42,43 +62,50 @@ namespace laz {
             if (m_streams.at(i)->get_status() != StreamStatus::CONNECTED)
             {
                 PLOGW << "Tried to read from unconnected camera '"<<m_streams.at(i)->get_name()<<". Abort.";
-                return img_bundle;
+                return;
             }
-            img_bundle[i] = m_streams.at(i)->read();
         }
-        return img_bundle;
-    }
 
-    std::vector<cv::Mat> StreamBundler::get_mask_bundle() const {
-        if (!m_cache.mask_bundle.empty())
-            return m_cache.mask_bundle;
+        if (!m_read_workers)
+        {
+            for (int i=0; i<m_streams.size(); i++)
+                _img_bundle[i] = this->timed_read(i);
+            return;
+        }
 
-        std::vector<cv::Mat> mask_bundle(m_streams.size());
-        for (int i=0; i<m_streams.size(); i++)
-            mask_bundle[i] = m_streams.at(i)->get_mask();
-        m_cache.mask_bundle = mask_bundle;
-        return mask_bundle;
+        // Fan out the reads (decode + remap) and join them into the bundle
+        m_read_workers->parallel_for(m_streams.size(), [this, &_img_bundle](const int& _idx) {
+            _img_bundle[_idx] = this->timed_read(_idx);
+        });
     }
 
-    std::vector<cv::Rect> StreamBundler::get_corners_bundle() const {
-        if (!m_cache.corners_bundle.empty())
-            return m_cache.corners_bundle;
+    cv::Mat StreamBundler::timed_read(const int& _idx) const
+    {
+        const auto start = std::chrono::steady_clock::now();
+        cv::Mat img = m_streams.at(_idx)->read();
+        const std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+        m_read_latencies[_idx] = elapsed.count();
+        m_read_histograms[_idx].record(elapsed.count());
+        return img;
+    }
 
-        std::vector<cv::Rect> corners_bundle(m_streams.size());
-        for (int i=0; i<m_streams.size(); i++)
-            corners_bundle[i] = m_streams.at(i)->get_corners();
-        m_cache.corners_bundle = corners_bundle;
-        return corners_bundle;
+    const std::vector<cv::Mat>& StreamBundler::get_mask_bundle() const {
+        this->init_cache();
+        return m_cache.get_mask_bundle();
     }
 
-    std::vector<cv::Size> StreamBundler::get_size_bundle() const {
-        if (!m_cache.size_bundle.empty())
-            return m_cache.size_bundle;
+    const std::vector<cv::Rect>& StreamBundler::get_corners_bundle() const {
+        this->init_cache();
+        return m_cache.get_corners_bundle();
+    }
 
-        std::vector<cv::Size> size_bundle(m_streams.size());
-        for (int i=0; i<m_streams.size(); i++)
-            size_bundle[i] = m_streams.at(i)->size();
-        m_cache.size_bundle = size_bundle;
-        return size_bundle;
+    const std::vector<cv::Size>& StreamBundler::get_size_bundle() const {
+        this->init_cache();
+        return m_cache.get_size_bundle();
+    }
+
+    BundleGeometryPtr StreamBundler::get_geometry() const {
+        this->init_cache();
+        return m_cache.geometry;
     }
 } // namespace laz
\ No newline at end of file
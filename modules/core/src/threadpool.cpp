@@ -0,0 +1,100 @@
+#include "core/threadpool.h"
+#include <assert.h>
+
+namespace laz {
+
+    ThreadPool::ThreadPool(const int& _nr_workers) :
+            m_stop(false),
+            m_batch_ctx(nullptr),
+            m_batch_invoke(nullptr),
+            m_batch_size(0),
+            m_batch_next(0),
+            m_batch_pending(0)
+    {
+        assert(_nr_workers > 0);
+        for (int i = 0; i < _nr_workers; i++)
+            m_workers.emplace_back(&ThreadPool::worker_loop, this);
+    }
+
+    ThreadPool::~ThreadPool()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_stop = true;
+        }
+        m_condition.notify_all();
+        // Workers drain the remaining tasks before leaving
+        for (std::thread& worker : m_workers)
+            worker.join();
+    }
+
+    void ThreadPool::worker_loop()
+    {
+        while (true)
+        {
+            std::function<void()> task;
+            int batch_idx = -1;
+            {
+                std::unique_lock<std::mutex> lock(m_mutex);
+                m_condition.wait(lock, [this]() {
+                    return m_stop or !m_tasks.empty() or m_batch_next < m_batch_size;
+                });
+                if (m_batch_next < m_batch_size)
+                    batch_idx = m_batch_next++;
+                else
+                {
+                    if (m_stop and m_tasks.empty())
+                        return;
+                    task = std::move(m_tasks.front());
+                    m_tasks.pop();
+                }
+            }
+            if (batch_idx >= 0)
+                this->run_batch_task(batch_idx);
+            else
+                task();
+        }
+    }
+
+    void ThreadPool::run_batch(const int& _nr_tasks, const void* _ctx, const BatchInvoker& _invoke)
+    {
+        if (_nr_tasks <= 0)
+            return;
+
+        std::lock_guard<std::mutex> batch_lock(m_batch_mutex);
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_batch_ctx = _ctx;
+        m_batch_invoke = _invoke;
+        m_batch_size = _nr_tasks;
+        m_batch_next = 0;
+        m_batch_pending = _nr_tasks;
+        m_condition.notify_all();
+        m_batch_done.wait(lock, [this]() { return m_batch_pending == 0; });
+
+        m_batch_size = 0;
+        m_batch_next = 0;
+        std::exception_ptr error = m_batch_error;
+        m_batch_error = nullptr;
+        lock.unlock();
+        if (error)
+            std::rethrow_exception(error);
+    }
+
+    void ThreadPool::run_batch_task(const int& _idx)
+    {
+        // The batch context is set before any index is handed out, and kept until all the tasks are completed
+        std::exception_ptr error;
+        try {
+            m_batch_invoke(m_batch_ctx, _idx);
+        }
+        catch (...) {
+            error = std::current_exception();
+        }
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (error and !m_batch_error)
+            m_batch_error = error;
+        if (--m_batch_pending == 0)
+            m_batch_done.notify_all();
+    }
+} // namespace laz
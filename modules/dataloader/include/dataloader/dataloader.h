@@ -13,6 +13,7 @@
 
 #include "core/camerastream.h"
 #include "core/streambundler.h"
+#include "core/mapcache.h"
 
 #pragma once
 
@@ -24,7 +25,8 @@
  *              cam1: {
  *                  "intrinsic": <list of float, len<9>>,
  *                  "dist_coeffs": <list of load, len<5>>,
- *                  "dims": [<width>, <height>]
+ *                  "dims": [<width>, <height>],
+ *                  "neighbors": <optional list of camera names>
  *              },
  *              ...
  *           }
@@ -77,6 +79,13 @@ namespace laz {
     nlohmann::json to_json(const ExtrinsicCamera& _cam);
     nlohmann::json to_json(const RotationCamera& _cam);
 
+    /**
+     * Parse the calibration of a camera once. Fields missing from the json are left empty.
+     * @param cam_name: Camera name from calibration json
+     * @param cam_json: Specific subjson from Calibration json
+     */
+    CameraParameters parameters_from_json(const std::string& cam_name, const nlohmann::json &cam_json);
+
     /**
      * Parse calibration file from camera calibration
      * @param cam_name: Camera name from calibration json
@@ -86,6 +95,14 @@ namespace laz {
     template<typename T>
     T* from_json(const std::string& cam_name, const nlohmann::json &cam_json);
 
+    /**
+     * Same as from_json, loading the final maps, mask and corners of the camera from a MapCache instead of
+     * computing them. Missing entries are computed and stored.
+     * @param map_cache: Cache keyed by the calibration entry and the camera type
+     */
+    template<typename T>
+    T* from_json(const std::string& cam_name, const nlohmann::json &cam_json, const MapCache& map_cache);
+
     /**
      * Parse calibration file from intrinsic camera calibration
      * @param cam_name: Bundle Calibration json
@@ -96,7 +113,24 @@ namespace laz {
     std::vector<std::tuple<T*,std::vector<std::string>>> load_fakestream(const std::string& calibration_path,
                                                                         const std::string& dataset_path);
 
+    /**
+     * Same as load_fakestream, with the camera maps cached in map_cache_dir.
+     * Only for CylindricalCamera, CvCylindricalCamera and CvSphericalCamera.
+     */
+    template<typename T>
+    std::vector<std::tuple<T*,std::vector<std::string>>> load_fakestream(const std::string& calibration_path,
+                                                                        const std::string& dataset_path,
+                                                                        const std::string& map_cache_dir);
+
     std::vector<CameraCalibration*> load_calibration_cams(const std::string& calibration_path, const std::string& dataset_path);
+
+    /**
+     * Image pairs of the extrinsic calibration to match, from the optional "neighbors" list of each camera of the
+     * calibration json: images of the same camera or of neighbouring cameras. Neighbourhood is symmetric.
+     * @param cameras: Images as returned by load_calibration_cams, named after their calibration json entry
+     * @return CV_8UC1 mask of cameras.size() squared, empty if no camera lists neighbors
+     */
+    cv::Mat load_match_mask(const std::string& calibration_path, const std::vector<CameraCalibration*>& cameras);
 } // namespace laz 
 
 #endif //LIVESTITCHER_DATALOADER_H
@@ -1,4 +1,8 @@
 #include <assert.h>
+#include <functional>
+#include <typeinfo>
+#include <set>
+#include <utility>
 #include "dataloader/dataloader.h"
 
 namespace fs = boost::filesystem;
@@ -49,54 +53,78 @@ namespace laz {
     // ----------------------------------------------------------------------------------------------
     // From Json
     // ----------------------------------------------------------------------------------------------
+    static cv::Mat matrix_from_json(const nlohmann::json& _json)
+    {
+        std::array < float, 9 > casted_coeffs = _json.get < std::array < float, 9 >> ();
+        return cv::Mat(3, 3, CV_32FC1, &casted_coeffs[0]).clone();
+    }
+
+    CameraParameters parameters_from_json(const std::string& cam_name, const nlohmann::json &cam_json)
+    {
+        CameraParameters parameters;
+        parameters.name = cam_name;
+        const auto casted_dims = cam_json["dims"].get < std::array < int, 2 >> ();
+        parameters.dims = cv::Size(casted_dims.at(0), casted_dims.at(1));
+        if (cam_json.contains("intrinsic"))
+            parameters.intrinsic = matrix_from_json(cam_json["intrinsic"]);
+        if (cam_json.contains("dist_coeffs"))
+            parameters.dist_coeffs = cv::Mat(cam_json["dist_coeffs"].get < std::vector < float >> (), true).reshape(1, 1);
+        if (cam_json.contains("extrinsic"))
+            parameters.extrinsic = matrix_from_json(cam_json["extrinsic"]);
+        if (cam_json.contains("rotation"))
+            parameters.rotation = matrix_from_json(cam_json["rotation"]);
+        if (cam_json.contains("focal"))
+            parameters.radius = cam_json["focal"].get<float>();
+        return parameters;
+    }
+
     template <>
     Camera* from_json<Camera>(const std::string& cam_name, const nlohmann::json &cam_json)
     {
-        const auto casted_dims = cam_json["dims"].get < std::array < int, 2 >> ();
-        return new Camera(cam_name, cv::Size(casted_dims.at(0), casted_dims.at(1)));
+        const CameraParameters parameters = parameters_from_json(cam_name, cam_json);
+        return new Camera(parameters.name, parameters.dims);
     }
 
     template <>
     IntrinsicCamera* from_json<IntrinsicCamera>(const std::string& cam_name, const nlohmann::json &cam_json)
     {
-        std::array < float, 9 > casted_intrinsic_coeffs = cam_json["intrinsic"].get < std::array < float, 9 >> ();
-        cv::Mat intrinsic(3, 3, CV_32FC1, &casted_intrinsic_coeffs[0]);
-        const auto casted_dist_coeffs = cam_json["dist_coeffs"].get < std::vector < float >> ();
-        Camera* cam = from_json<Camera>(cam_name, cam_json);
-        auto* intrinsic_cam = new IntrinsicCamera(*cam, intrinsic, casted_dist_coeffs);
-        delete cam; cam = nullptr;
-        return intrinsic_cam;
+        return new IntrinsicCamera(parameters_from_json(cam_name, cam_json));
     }
 
     template <>
     ExtrinsicCamera* from_json<ExtrinsicCamera>(const std::string& cam_name, const nlohmann::json &cam_json)
     {
-        std::array < float, 9 > casted_extrinsic = cam_json["extrinsic"].get <std::array<float, 9>>();
-        cv::Mat extrinsic(3, 3, CV_32FC1, &casted_extrinsic[0]);
-        IntrinsicCamera* intrinsic_cam = from_json<IntrinsicCamera>(cam_name, cam_json);
-        auto* extrinsic_cam = new ExtrinsicCamera(*intrinsic_cam, extrinsic);
-        delete intrinsic_cam; intrinsic_cam = nullptr;
-        return extrinsic_cam;
+        return new ExtrinsicCamera(parameters_from_json(cam_name, cam_json));
     }
 
     template <>
     RotationCamera* from_json<RotationCamera>(const std::string& cam_name, const nlohmann::json &cam_json)
     {
-        std::array < float, 9 > casted_rotation = cam_json["rotation"].get <std::array<float, 9>>();
-        cv::Mat rotation(3, 3, CV_32FC1, &casted_rotation[0]);
-        const float &focal_length = cam_json["focal"].get<float>();
-        ExtrinsicCamera* extrinsic_cam = from_json<ExtrinsicCamera>(cam_name, cam_json);
-        auto* rot_cam = new RotationCamera(*extrinsic_cam, rotation, focal_length);
-        delete extrinsic_cam; extrinsic_cam = nullptr;
-        return rot_cam;
+        return new RotationCamera(parameters_from_json(cam_name, cam_json));
     }
 
     template <typename T>
     T* from_json(const std::string& cam_name, const nlohmann::json &cam_json)
     {
-        RotationCamera* rotation_cam = from_json<RotationCamera>(cam_name, cam_json);
-        auto* cam = new T(*rotation_cam);
-        delete rotation_cam; rotation_cam = nullptr;
+        // Maps are built on first use: the intermediate RotationCamera costs no map computation
+        return new T(RotationCamera(parameters_from_json(cam_name, cam_json)));
+    }
+
+    template <typename T>
+    T* from_json(const std::string& cam_name, const nlohmann::json &cam_json, const MapCache& map_cache)
+    {
+        // The calibration entry is dumped with sorted keys: equal calibrations give equal keys
+        const std::string key = MapCache::make_key(cam_json.dump(), typeid(T).name());
+        CameraMaps maps;
+        if (map_cache.load(key, maps))
+        {
+            PLOGI << "Loaded '" << cam_name << "' maps from '" << map_cache.get_path(key) << "'.";
+            return new T(RotationCamera(parameters_from_json(cam_name, cam_json)), maps);
+        }
+
+        T* cam = from_json<T>(cam_name, cam_json);
+        map_cache.store(key, cam->get_maps());
+        PLOGI << "Stored '" << cam_name << "' maps to '" << map_cache.get_path(key) << "'.";
         return cam;
     }
 
@@ -106,6 +134,12 @@ namespace laz {
             const nlohmann::json &cam_json);
     template CylindricalCamera* from_json<CylindricalCamera>(const std::string& cam_name,
             const nlohmann::json &cam_json);
+    template CvCylindricalCamera* from_json<CvCylindricalCamera>(const std::string& cam_name,
+            const nlohmann::json &cam_json, const MapCache& map_cache);
+    template CvSphericalCamera* from_json<CvSphericalCamera>(const std::string& cam_name,
+            const nlohmann::json &cam_json, const MapCache& map_cache);
+    template CylindricalCamera* from_json<CylindricalCamera>(const std::string& cam_name,
+            const nlohmann::json &cam_json, const MapCache& map_cache);
 
     // ----------------------------------------------------------------------------------------------
     // CameraFakeStream Loader
@@ -122,7 +156,9 @@ namespace laz {
     }
 
     template<typename T>
-    std::vector<std::tuple<T*,std::vector<std::string>>> load_fakestream(const std::string& calibration_path, const std::string& dataset_path)
+    static std::vector<std::tuple<T*,std::vector<std::string>>> load_fakestream_cameras(
+            const std::string& calibration_path, const std::string& dataset_path,
+            const std::function<T*(const std::string&, const nlohmann::json&)>& make_camera)
     {
         // Parse cylindrical calibration json
         std::ifstream calibration_file(calibration_path);
@@ -148,7 +184,7 @@ namespace laz {
             for(auto& img_path : img_paths)
                 to_abs_path(img_path, dataset_path);
 
-            T* cam = from_json<T>(cam_name, cam_json);
+            T* cam = make_camera(cam_name, cam_json);
             std::tuple<T*,std::vector<std::string>> tuple = std::make_tuple(cam, img_paths);
             cameras.push_back( tuple );
         }
@@ -156,6 +192,27 @@ namespace laz {
         return cameras;
     }
 
+    template<typename T>
+    std::vector<std::tuple<T*,std::vector<std::string>>> load_fakestream(const std::string& calibration_path, const std::string& dataset_path)
+    {
+        return load_fakestream_cameras<T>(calibration_path, dataset_path,
+                                  [](const std::string& cam_name, const nlohmann::json& cam_json) {
+                                      return from_json<T>(cam_name, cam_json);
+                                  });
+    }
+
+    template<typename T>
+    std::vector<std::tuple<T*,std::vector<std::string>>> load_fakestream(const std::string& calibration_path,
+                                                                        const std::string& dataset_path,
+                                                                        const std::string& map_cache_dir)
+    {
+        const MapCache map_cache(map_cache_dir);
+        return load_fakestream_cameras<T>(calibration_path, dataset_path,
+                                  [&map_cache](const std::string& cam_name, const nlohmann::json& cam_json) {
+                                      return from_json<T>(cam_name, cam_json, map_cache);
+                                  });
+    }
+
     template std::vector<std::tuple<IntrinsicCamera*,std::vector<std::string>>>
             load_fakestream<IntrinsicCamera>(const std::string& calibration_path, const std::string& dataset_path);
     template std::vector<std::tuple<ExtrinsicCamera*,std::vector<std::string>>>
@@ -166,6 +223,15 @@ namespace laz {
             load_fakestream<CvCylindricalCamera>(const std::string& calibration_path, const std::string& dataset_path);
     template std::vector<std::tuple<CvSphericalCamera*,std::vector<std::string>>>
     load_fakestream<CvSphericalCamera>(const std::string& calibration_path, const std::string& dataset_path);
+    template std::vector<std::tuple<CylindricalCamera*,std::vector<std::string>>>
+            load_fakestream<CylindricalCamera>(const std::string& calibration_path, const std::string& dataset_path,
+                                               const std::string& map_cache_dir);
+    template std::vector<std::tuple<CvCylindricalCamera*,std::vector<std::string>>>
+            load_fakestream<CvCylindricalCamera>(const std::string& calibration_path, const std::string& dataset_path,
+                                                 const std::string& map_cache_dir);
+    template std::vector<std::tuple<CvSphericalCamera*,std::vector<std::string>>>
+            load_fakestream<CvSphericalCamera>(const std::string& calibration_path, const std::string& dataset_path,
+                                               const std::string& map_cache_dir);
 
 
     // ----------------------------------------------------------------------------------------------
@@ -191,12 +257,11 @@ namespace laz {
 
             const nlohmann::json imgpaths_json = dataset_json[cam_name];
             std::vector<std::string> img_paths = imgpaths_json.get<std::vector<std::string>>();
+            // All the images of a camera share its maps, built once on first use
+            const IntrinsicCamera intrinsic_cam(parameters_from_json(cam_name, cam_json));
             for(auto& img_path : img_paths) {
                 to_abs_path(img_path, dataset_path);
-                IntrinsicCamera* intrinsic_cam = from_json<IntrinsicCamera>(cam_name, cam_json);
-                auto* calib_cam = new CameraCalibration(*intrinsic_cam, img_path);
-                delete intrinsic_cam; intrinsic_cam = nullptr;
-                cameras.push_back(calib_cam);
+                cameras.push_back(new CameraCalibration(intrinsic_cam, img_path));
             }
             PLOGI << "Camera '" << cam_name << "' registered.";
         }
@@ -204,4 +269,34 @@ namespace laz {
         return cameras;
     }
 
+    cv::Mat load_match_mask(const std::string& calibration_path, const std::vector<CameraCalibration*>& cameras)
+    {
+        std::ifstream calibration_file(calibration_path);
+        const nlohmann::json& calibration_json = nlohmann::json::parse(calibration_file);
+
+        std::set<std::pair<std::string, std::string>> neighbors;
+        for (const auto& [cam_name, cam_json] : calibration_json["cameras"].items()) {
+            if (not cam_json.contains("neighbors"))
+                continue;
+            for (const auto& neighbor_name : cam_json["neighbors"].get<std::vector<std::string>>()) {
+                if (not calibration_json["cameras"].contains(neighbor_name))
+                    PLOGW << "Unknown neighbor '" << neighbor_name << "' of camera '" << cam_name << "'.";
+                neighbors.emplace(cam_name, neighbor_name);
+                neighbors.emplace(neighbor_name, cam_name);
+            }
+        }
+        if (neighbors.empty())
+            return cv::Mat();
+
+        cv::Mat mask = cv::Mat::zeros(cameras.size(), cameras.size(), CV_8UC1);
+        for (int i = 0; i < cameras.size(); i++)
+            for (int j = 0; j < cameras.size(); j++) {
+                const std::string& name_i = cameras[i]->get_name();
+                const std::string& name_j = cameras[j]->get_name();
+                if (name_i == name_j || neighbors.count({name_i, name_j}))
+                    mask.at<uchar>(i, j) = 1;
+            }
+        return mask;
+    }
+
 } // namespace laz
\ No newline at end of file
@@ -7,49 +7,91 @@
 
 #include <plog/Log.h>
 
+#include "core/bundlegeometry.h"
+
 namespace laz {
 
     class Blender {
     public:
         Blender() = default;
         virtual ~Blender(){};
-        virtual void init(const std::vector <cv::Mat>& _mask_bundle,
-                          const std::vector <cv::Rect>& _corners_bundle,
-                          const std::vector <cv::Size>& _size_bundle) = 0;
+        virtual void init(const BundleGeometryPtr& _geometry) = 0;
 
         virtual void update_masks(const std::vector <cv::Mat>& _mask_bundle);
         virtual void update_corners(const std::vector <cv::Rect>& _corners_bundle);
         virtual void update_sizes( const std::vector <cv::Size>& _size_bundle);
 
+        /**
+         * Blend the images into the mosaic.
+         * @param _dst : mosaic, written in place when it already has the output size and type. It may be an ROI
+         * of a larger caller-owned buffer.
+         */
         virtual void blend(const std::vector <cv::Mat>& _images_bundle, cv::OutputArray _dst) = 0;
 
+        /**
+         * @return OpenCV type of the blended mosaic
+         */
+        virtual int output_type() const = 0;
+
+        /**
+         * @return size of the blended mosaic
+         */
+        cv::Size output_size() const;
+
     protected:
-        std::vector <cv::Mat> m_mask_bundle;
-        std::vector <cv::Point> m_tl_point_bundle;
-        std::vector <cv::Size> m_size_bundle;
+        BundleGeometryPtr m_geometry;
     };
 
     class CvBlender : public Blender {
     public:
         CvBlender(const float& _blend_strength=5.f);
 
-        virtual void init(const std::vector <cv::Mat>& _mask_bundle,
-                          const std::vector <cv::Rect>& _corners_bundle,
-                          const std::vector <cv::Size>& _size_bundle) override;
+        virtual void init(const BundleGeometryPtr& _geometry) override;
 
+        /**
+         * cv::detail::Blender allocates its accumulators on every frame: the mosaic is copied into _dst.
+         */
         virtual void blend(const std::vector <cv::Mat>& _images_bundle, cv::OutputArray _dst) override;
 
+        virtual int output_type() const override { return CV_16SC3; }
+
     private:
         float get_blend_width(const float& _blend_strength);
 
     protected:
         float m_blend_width;
         cv::Ptr<cv::detail::Blender> m_blender;
+        std::vector <cv::Mat> m_image_s_bundle;  // CV_16S copies of the images fed to m_blender
     };
 
+    /**
+     * Same result as cv::detail::FeatherBlender, accumulated in place in the caller mosaic. The feather
+     * weight maps and their sum only depend on the geometry: they are computed once per geometry, and
+     * blending a frame allocates nothing.
+     */
     class CvBlenderFeather : public CvBlender {
     public:
         explicit CvBlenderFeather(const float& _blend_strength=5.f);
+
+        virtual void init(const BundleGeometryPtr& _geometry) override;
+
+        virtual void update_masks(const std::vector <cv::Mat>& _mask_bundle) override;
+        virtual void update_corners(const std::vector <cv::Rect>& _corners_bundle) override;
+        virtual void update_sizes( const std::vector <cv::Size>& _size_bundle) override;
+
+        virtual void blend(const std::vector <cv::Mat>& _images_bundle, cv::OutputArray _dst) override;
+
+        float get_sharpness() const { return m_sharpness; }
+
+    private:
+        void prepare_weights();
+
+        float m_sharpness;
+        BundleGeometryPtr m_prepared_geometry;
+        cv::Rect m_dst_roi;
+        std::vector <cv::Rect> m_roi_bundle;      // Camera area in the mosaic
+        std::vector <cv::Mat> m_weight_bundle;    // CV_32F feather weights
+        cv::Mat m_weight_sum;
     };
 
     class CvBlenderMultiBand : public CvBlender {
@@ -57,6 +99,132 @@ namespace laz {
         explicit CvBlenderMultiBand(const float& _blend_strength=5.f);
     };
 
+    /**
+     * Blends the mosaic by stripes cut along its longest side, on parallel workers. Each stripe has its own
+     * cv::detail::Blender (FEATHER or MULTI_BAND) fed only with the image regions intersecting it. Stripes
+     * overlap by a halo covering the blending support, and only their core is written to the CV_16SC3 mosaic.
+     * Multi-band stripes are cut on the pyramid grid of a single blender over the mosaic.
+     */
+    class CvBlenderStripes : public Blender {
+    public:
+        /**
+         * @param _blender_type : cv::detail::Blender::FEATHER or cv::detail::Blender::MULTI_BAND
+         * @param _nr_stripes : number of stripes, 0 for one stripe per OpenCV thread
+         * @param _blend_strength : blending strength from [0,100] range
+         */
+        explicit CvBlenderStripes(const int& _blender_type=cv::detail::Blender::FEATHER,
+                                  const int& _nr_stripes=0,
+                                  const float& _blend_strength=5.f);
+
+        virtual void init(const BundleGeometryPtr& _geometry) override;
+
+        virtual void update_masks(const std::vector <cv::Mat>& _mask_bundle) override;
+        virtual void update_corners(const std::vector <cv::Rect>& _corners_bundle) override;
+        virtual void update_sizes( const std::vector <cv::Size>& _size_bundle) override;
+
+        virtual void blend(const std::vector <cv::Mat>& _images_bundle, cv::OutputArray _dst) override;
+
+        virtual int output_type() const override { return CV_16SC3; }
+
+        float get_sharpness() const { return 1.f / m_blend_width; }
+        int get_num_bands() const;
+
+    private:
+        class Stripe {
+        public:
+            cv::Rect core;                  // Part of the mosaic written by this stripe
+            cv::Rect roi;                   // Core with its halo, blended by this stripe
+            std::vector<int> cam_indices;   // Cameras intersecting the roi
+            cv::Ptr<cv::detail::Blender> blender;
+        };
+
+        void prepare_stripes();
+        cv::Ptr<cv::detail::Blender> create_blender() const;
+
+        int m_blender_type;
+        int m_nr_stripes;
+        float m_blend_strength;
+        float m_blend_width;
+        cv::Rect m_dst_roi;
+        std::vector<Stripe> m_stripes;
+    };
+
+    /**
+     * Feather blender for static rigs. The normalized feather weights are computed once per geometry
+     * (init and update_*) instead of on every frame. Pixels seen by a single camera are copied as is and
+     * the weighted accumulation only runs over the overlap regions, with 8-bit fixed-point weights.
+     * Blends CV_8UC3 images into a CV_8UC3 mosaic.
+     */
+    class BlenderStaticFeather : public Blender {
+    public:
+        explicit BlenderStaticFeather(const float& _blend_strength=5.f);
+
+        virtual void init(const BundleGeometryPtr& _geometry) override;
+
+        virtual void update_masks(const std::vector <cv::Mat>& _mask_bundle) override;
+        virtual void update_corners(const std::vector <cv::Rect>& _corners_bundle) override;
+        virtual void update_sizes( const std::vector <cv::Size>& _size_bundle) override;
+
+        virtual void blend(const std::vector <cv::Mat>& _images_bundle, cv::OutputArray _dst) override;
+
+        virtual int output_type() const override { return CV_8UC3; }
+
+    private:
+        void prepare_weights();
+
+        float m_blend_strength;
+        BundleGeometryPtr m_prepared_geometry;
+        cv::Rect m_dst_roi;
+        std::vector <cv::Rect> m_roi_bundle;             // Camera area in the mosaic
+        std::vector <cv::Mat> m_solo_mask_bundle;        // Pixels seen by this camera only
+        std::vector <cv::Rect> m_overlap_roi_bundle;     // Overlap bounding box, in camera coordinates
+        std::vector <cv::Mat> m_overlap_weight_bundle;   // CV_16UC3 weights over the overlap box, sum to 256
+        cv::Mat m_overlap_mask;
+        cv::Mat m_accumulator;
+        cv::Mat m_overlap_buffer;
+    };
+
+    /**
+     * Multi-band blender for static rigs, equivalent to cv::detail::MultiBandBlender computed in 32-bit float.
+     * The Gaussian pyramids of the weights are built and normalized once per geometry, and every pyramid
+     * buffer is kept between frames: blending a frame allocates nothing. Pyramids are only rebuilt when
+     * update_* actually changes the geometry. Blends CV_8UC3 images into a CV_8UC3 mosaic.
+     */
+    class BlenderStaticMultiBand : public Blender {
+    public:
+        explicit BlenderStaticMultiBand(const float& _blend_strength=5.f);
+
+        virtual void init(const BundleGeometryPtr& _geometry) override;
+
+        virtual void update_masks(const std::vector <cv::Mat>& _mask_bundle) override;
+        virtual void update_corners(const std::vector <cv::Rect>& _corners_bundle) override;
+        virtual void update_sizes( const std::vector <cv::Size>& _size_bundle) override;
+
+        virtual void blend(const std::vector <cv::Mat>& _images_bundle, cv::OutputArray _dst) override;
+
+        virtual int output_type() const override { return CV_8UC3; }
+
+        int get_nr_bands() const { return m_nr_bands; }
+
+    private:
+        void prepare_pyramids();
+
+        float m_blend_strength;
+        int m_nr_bands;
+        BundleGeometryPtr m_prepared_geometry;
+        cv::Rect m_dst_roi;                                          // Mosaic area, padded to the band alignment
+        cv::Rect m_dst_roi_final;
+        cv::Mat m_dst_empty_mask;
+        std::vector <cv::Mat> m_dst_pyr;                             // Laplacian pyramid of the mosaic
+        std::vector <cv::Mat> m_dst_up_pyr;
+        std::vector <cv::Rect> m_roi_bundle;                         // Padded camera area in the mosaic
+        std::vector <cv::Vec4i> m_border_bundle;                     // Top, bottom, left and right padding
+        std::vector <std::vector <cv::Mat>> m_weight_pyr_bundle;     // Normalized CV_32FC3 weights
+        std::vector <std::vector <cv::Mat>> m_src_pyr_bundle;
+        std::vector <std::vector <cv::Mat>> m_src_up_pyr_bundle;
+        std::vector <cv::Mat> m_border_buffer_bundle;
+    };
+
 } // namespace laz
 
 #endif //LIVESTITCHER_BLENDER_H
@@ -1,40 +1,95 @@
 #ifndef LIVESTITCHER_EXPOSURECOMPENSATOR_H
 #define LIVESTITCHER_EXPOSURECOMPENSATOR_H
 #include <vector>
+#include <array>
+#include <atomic>
+#include <memory>
 #include <opencv2/core.hpp>
 #include <opencv2/stitching/detail/exposure_compensate.hpp>
 
 #include <plog/Log.h>
 
+#include "core/bundlegeometry.h"
+
 namespace laz {
 
     class ExposureCompensator {
     public:
         ExposureCompensator() = default;
         virtual ~ExposureCompensator() = default;
-        virtual void init(const std::vector <cv::Mat>& img_bundle,
-                          const std::vector <cv::Mat>& mask_bundle,
-                          const std::vector <cv::Rect>& corners_bundle) = 0;
+        virtual void init(const std::vector <cv::Mat>& img_bundle, const BundleGeometryPtr& geometry) = 0;
+
+        /**
+         * Re-estimate the exposure from new images, keeping the geometry given at init.
+         * Implementations may run it on another thread than apply().
+         */
+        virtual void update(const std::vector <cv::Mat>& img_bundle) { this->init(img_bundle, m_geometry); }
 
         virtual void apply(std::vector <cv::Mat>& _img_bundle) const = 0;
 
     protected:
-        std::vector <cv::Mat> m_mask_bundle;
-        std::vector <cv::Point> m_tl_point_bundle;
+        BundleGeometryPtr m_geometry;
     };
 
     class CvExposureCompensator : public ExposureCompensator {
     public:
-        CvExposureCompensator() = default;
+        CvExposureCompensator() : m_smoothing(1.f), m_published_slot(1), m_back_slot(2), m_front_slot(0) {};
         virtual ~CvExposureCompensator() = default;
-        virtual void init(const std::vector <cv::Mat>& img_bundle,
-                          const std::vector <cv::Mat>& mask_bundle,
-                          const std::vector <cv::Rect>& corners_bundle) override;
+        virtual void init(const std::vector <cv::Mat>& img_bundle, const BundleGeometryPtr& geometry) override;
+
+        /**
+         * Re-estimate the gains and blend them with the current ones. Safe to run concurrently with apply():
+         * the new gains are published once complete, without locking. At most one thread updates at a time.
+         */
+        virtual void update(const std::vector <cv::Mat>& img_bundle) override;
 
+        /**
+         * Apply the latest published gains, in a single pass over each CV_8UC3 image. At most one thread applies
+         * at a time.
+         */
         virtual void apply(std::vector <cv::Mat>& _img_bundle) const override;
 
+        /**
+         * Exponential smoothing factor of the gains on update: 1 keeps the new gains only, lower values
+         * follow lighting changes more slowly but without flicker.
+         */
+        void set_smoothing(const float& _smoothing);
+
     protected:
+        /**
+         * Gains fitted by the compensator along with their applicable form: per-channel LUTs for GAIN and
+         * CHANNELS, full-resolution gain maps for the BLOCKS compensators.
+         */
+        class GainBundle {
+        public:
+            std::vector <cv::Mat> raw_gain_bundle;
+            std::vector <cv::Mat> lut_bundle;    // 1x256 CV_8UC3
+            std::vector <cv::Mat> map_bundle;    // CV_16UC3 Q12 fixed-point
+        };
+
+        std::vector <cv::Mat> estimate_gains(const std::vector <cv::Mat>& img_bundle);
+        GainBundle materialize_gains(const std::vector <cv::Mat>& _raw_gain_bundle) const;
+
+        /**
+         * Fill the back slot with the gains and swap it with the published slot, marked as new.
+         */
+        void publish_gains(GainBundle&& _gains);
+
+        /**
+         * Swap the front slot with the published slot if the latter is new, and return the front slot.
+         */
+        const GainBundle& acquire_gains() const;
+
         cv::Ptr<cv::detail::ExposureCompensator> m_compensator{};
+        float m_smoothing;
+
+        // Triple buffer of gains: the back slot belongs to the updating thread, the front slot to the applying
+        // thread. The published slot index and its newness flag share one atomic byte, exchanged by both sides.
+        std::array<GainBundle, 3> m_gain_slots;
+        mutable std::atomic<uint8_t> m_published_slot;
+        uint8_t m_back_slot;
+        mutable uint8_t m_front_slot;
+        std::vector <cv::Mat> m_raw_gain_bundle;    // Last published raw gains, owned by the updating thread
     };
 
     class CvExposureCompensatorGain : public CvExposureCompensator {
@@ -1,5 +1,6 @@
 #ifndef LIVESTITCHER_LIGHTENINGCOMPENSATOR_H
 #define LIVESTITCHER_LIGHTENINGCOMPENSATOR_H
+#include <array>
 #include <opencv2/core.hpp>
 #include <opencv2/imgproc.hpp>
 
@@ -17,11 +18,15 @@ namespace laz {
         GammaCorrector(const float& _alpha, const uint8_t& _beta);
         virtual ~GammaCorrector() = default;
 
+        /**
+         * Apply min(alpha * img + beta, mask) in place, in a single pass over each CV_8U image.
+         */
         virtual void apply(std::vector <cv::Mat> &_img_bundle, const std::vector<cv::Mat>& _mask_bundle);
 
     protected:
         float m_alpha;
         uint8_t m_beta;
+        std::array<uchar, 256> m_lut;
 
         std::vector<cv::Mat> m_gamma_maps;
     };
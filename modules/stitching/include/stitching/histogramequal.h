@@ -6,24 +6,54 @@
 #include <plog/Log.h>
 
 namespace laz {
+
+    enum EqualizationMode {
+        LAB = 0,    // Equalize the L plane of the Lab image
+        LUMA        // Equalize the luma and shift the BGR pixels by the luma change, without color conversion
+    };
+
     class HistogramEqualizer {
     public:
         /**
-         *
-         * @param alpha : Simple contrast control [1.0-3.0]
-         * @param beta : Simple brightness control [0-100]
+         * Contrast Limited Adaptive Histogram Equalization (CLAHE) of CV_8UC3 images.
+         * Tile histograms only count the masked pixels, and out-of-mask pixels are not equalized.
+         * @param _mode : Plane on which the equalization is computed
+         * @param _clip_limit : Contrast limit, relative to a uniform histogram
+         * @param _tile_grid : Number of tiles in each direction
          */
-        HistogramEqualizer() = default;
+        explicit HistogramEqualizer(const EqualizationMode& _mode=EqualizationMode::LAB,
+                                    const float& _clip_limit=4.f,
+                                    const cv::Size& _tile_grid=cv::Size(8, 8));
 
         virtual ~HistogramEqualizer() = default;
 
         virtual void apply(std::vector <cv::Mat> &_img_bundle, const std::vector <cv::Mat> &_mask_bundle);
 
     protected:
-        float m_alpha;
-        uint8_t m_beta;
+        /**
+         * Per-camera CLAHE state kept between frames: interpolation coordinates, tile LUTs and buffers.
+         */
+        class ClaheState {
+        public:
+            void init(const cv::Size& _size, const cv::Size& _tile_grid);
+
+            cv::Size size;
+            std::vector<int> x_offsets1, x_offsets2;    // Offsets of the left/right tile LUTs, per column
+            std::vector<float> x_weights;
+            std::vector<int> y_tiles1, y_tiles2;        // Top/bottom tile rows, per row
+            std::vector<float> y_weights;
+            cv::Mat luts;                               // One 256 entries row per tile
+            cv::Mat plane;
+            cv::Mat lab;
+        };
+
+        void compute_luts(ClaheState& _state, const cv::Mat& _mask) const;
+
+        EqualizationMode m_mode;
+        float m_clip_limit;
+        cv::Size m_tile_grid;
 
-        std::vector <cv::Mat> m_gamma_maps;
+        std::vector <ClaheState> m_state_bundle;
     };
 } //namespace laz
 
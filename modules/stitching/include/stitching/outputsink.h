@@ -0,0 +1,139 @@
+#ifndef LIVESTITCHER_OUTPUTSINK_H
+#define LIVESTITCHER_OUTPUTSINK_H
+#include <vector>
+#include <string>
+#include <memory>
+#include <thread>
+#include <fstream>
+#include <opencv2/core.hpp>
+#include <opencv2/imgcodecs.hpp>
+#include <opencv2/videoio.hpp>
+
+#include <plog/Log.h>
+
+#include "core/boundedqueue.h"
+
+namespace laz {
+
+    /**
+     * Destination of the stitched mosaics.
+     */
+    class OutputSink {
+    public:
+        OutputSink() = default;
+        virtual ~OutputSink() = default;
+
+        virtual void write(const cv::Mat& _mosaic) = 0;
+
+        /**
+         * Flush and release the destination. Called by the destructor of the sinks.
+         */
+        virtual void close() {};
+    };
+
+    /**
+     * Discards the mosaics, to benchmark the stitching alone.
+     */
+    class NullSink : public OutputSink {
+    public:
+        virtual void write(const cv::Mat& _mosaic) override {};
+    };
+
+    /**
+     * Writes each mosaic to its own image file: <prefix>_<frame number>.<extension>
+     */
+    class ImageSink : public OutputSink {
+    public:
+        ImageSink(const std::string& _prefix, const std::string& _extension, const std::vector<int>& _params={});
+
+        virtual void write(const cv::Mat& _mosaic) override;
+
+    private:
+        std::string m_prefix;
+        std::string m_extension;
+        std::vector<int> m_params;
+        int m_frame_idx;
+    };
+
+    class PngSink : public ImageSink {
+    public:
+        explicit PngSink(const std::string& _prefix);
+    };
+
+    class JpegSink : public ImageSink {
+    public:
+        /**
+         * @param _quality : JPEG quality from [0,100] range
+         */
+        explicit JpegSink(const std::string& _prefix, const int& _quality=95);
+    };
+
+    /**
+     * Encodes the mosaics in a video file. The writer is opened on the first mosaic, which sets the frame size.
+     */
+    class VideoSink : public OutputSink {
+    public:
+        /**
+         * @param _codec : FourCC code of the codec, ex. "MJPG" or "FFV1"
+         */
+        VideoSink(const std::string& _path, const std::string& _codec="MJPG", const double& _fps=30.);
+        virtual ~VideoSink();
+
+        virtual void write(const cv::Mat& _mosaic) override;
+        virtual void close() override;
+
+    private:
+        std::string m_path;
+        int m_fourcc;
+        double m_fps;
+        cv::VideoWriter m_writer;
+    };
+
+    /**
+     * Appends the mosaics uncompressed to a single file. Each frame is preceded by its header:
+     * rows, cols and OpenCV type as 32-bit integers.
+     */
+    class RawSink : public OutputSink {
+    public:
+        explicit RawSink(const std::string& _path);
+        virtual ~RawSink();
+
+        virtual void write(const cv::Mat& _mosaic) override;
+        virtual void close() override;
+
+    private:
+        std::ofstream m_file;
+    };
+
+    /**
+     * Forwards the mosaics to another sink from a writer thread, through a bounded queue. write() copies the
+     * mosaic and only blocks when the queue is full.
+     */
+    class AsyncSink : public OutputSink {
+    public:
+        AsyncSink(std::unique_ptr<OutputSink> _sink, const int& _queue_capacity=4);
+        virtual ~AsyncSink();
+
+        AsyncSink(const AsyncSink&) = delete;
+        AsyncSink& operator=(const AsyncSink&) = delete;
+
+        virtual void write(const cv::Mat& _mosaic) override;
+
+        /**
+         * Wait for the queued mosaics to be written, then close the underlying sink.
+         */
+        virtual void close() override;
+
+        int get_queue_depth() const { return m_queue.size(); }
+
+    private:
+        void writer_loop();
+
+        std::unique_ptr<OutputSink> m_sink;
+        BoundedQueue<cv::Mat> m_queue;
+        std::thread m_writer;
+    };
+
+} //namespace laz
+
+#endif //LIVESTITCHER_OUTPUTSINK_H
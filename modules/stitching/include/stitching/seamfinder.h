@@ -7,16 +7,16 @@
 
 #include <plog/Log.h>
 
+#include "core/bundlegeometry.h"
+
 namespace laz {
 
     class SeamFinder {
     public:
         SeamFinder(const float& _seam_downscale=0.5f): m_seam_downscale(_seam_downscale){};
         virtual ~SeamFinder() = default;
-        virtual void  init(const std::vector <cv::Mat>& img_bundle,
-                           const std::vector <cv::Mat>& mask_bundle,
-                           const std::vector <cv::Rect>& corners_bundle) = 0;
-        std::vector <cv::Mat> get_seam_masks() const { return m_seam_masks; };
+        virtual void  init(const std::vector <cv::Mat>& img_bundle, const BundleGeometryPtr& geometry) = 0;
+        const std::vector <cv::Mat>& get_seam_masks() const { return m_seam_masks; };
 
     protected:
         std::vector <cv::Mat> m_seam_masks;
@@ -27,9 +27,7 @@ namespace laz {
     public:
         CvSeamFinder(const float& _seam_downscale=0.5f) : m_seam_finder(nullptr), SeamFinder(_seam_downscale) {};
         virtual ~CvSeamFinder() = default;
-        virtual void init(const std::vector <cv::Mat>& img_bundle,
-                          const std::vector <cv::Mat>& mask_bundle,
-                          const std::vector <cv::Rect>& corners_bundle) override;
+        virtual void init(const std::vector <cv::Mat>& img_bundle, const BundleGeometryPtr& geometry) override;
 
     protected:
         cv::Ptr<cv::detail::SeamFinder> m_seam_finder;
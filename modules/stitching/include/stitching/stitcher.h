@@ -5,12 +5,23 @@
 #ifndef LIVESTITCHER_STITCHER_H
 #define LIVESTITCHER_STITCHER_H
 #include <vector>
+#include <array>
+#include <string>
 #include <memory>
+#include <future>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <exception>
 #include <cmath>
 
 #include <plog/Log.h>
 
 #include "core/streambundler.h"
+#include "core/threadpool.h"
+#include "core/boundedqueue.h"
+#include "core/shmring.h"
+#include "core/latencyhistogram.h"
 #include "stitching/gammacorrector.h"
 #include "stitching/exposurecompensator.h"
 #include "stitching/seamfinder.h"
@@ -41,6 +52,40 @@ namespace laz {
             friend class StitcherBuilder;
         };
 
+        class StitcherOptions {
+
+        private:
+
+            StitcherOptions() : async_seam_update(false),
+                                exposure_update_cadence(0),
+                                pipeline_queue_capacity(0)
+                                {}
+
+            bool async_seam_update;
+            int exposure_update_cadence;
+            int pipeline_queue_capacity;
+
+            friend class Stitcher;
+            friend class StitcherBuilder;
+        };
+
+        /**
+         * Frame travelling through the stitching stages.
+         */
+        class Frame {
+        public:
+            std::vector<cv::Mat> img_bundle;
+            std::shared_ptr<const std::vector<cv::Mat>> seam_masks;   // New seams, to be used from this frame on
+            cv::Mat mosaic;
+        };
+
+        enum Stage {
+            CAPTURE = 0,
+            CORRECT,
+            BLEND,
+            NR_STAGES
+        };
+
     public:
         class StitcherBuilder {
         public:
@@ -70,14 +115,90 @@ namespace laz {
                 return *this;
             }
 
+            /**
+             * Re-estimate the seams on a background thread when an update is requested in read(). Stitching keeps
+             * the current seams until the new ones are ready, then swaps them in at a frame boundary.
+             */
+            StitcherBuilder &enable_async_seam_update() {
+                m_options.async_seam_update = true;
+                return *this;
+            }
+
+            /**
+             * Re-estimate the exposure on a background thread, every _cadence frames, when an update is requested
+             * in read(). New gains are picked up by the compensator as soon as they are published.
+             */
+            StitcherBuilder &enable_async_exposure_update(const int& _cadence=1) {
+                assert(_cadence > 0);
+                m_options.exposure_update_cadence = _cadence;
+                return *this;
+            }
+
+            /**
+             * Run the capture, correction (gamma, exposure, seams) and blending stages on their own threads,
+             * connected by queues of _queue_capacity frames. Frame N+1 is captured and corrected while frame N
+             * is blended; read() returns the mosaics in capture order.
+             */
+            StitcherBuilder &enable_pipeline(const int& _queue_capacity=2) {
+                assert(_queue_capacity > 0);
+                m_options.pipeline_queue_capacity = _queue_capacity;
+                return *this;
+            }
+
             Stitcher build() {
-                return Stitcher(m_components);
+                return Stitcher(m_components, m_options);
             }
 
         private:
             StitcherComponents m_components;
+            StitcherOptions m_options;
         };
 
+        /**
+         * Per-stage statistics. The queue depth is the number of frames waiting for the stage (pipelined mode).
+         */
+        class StageStats {
+        public:
+            std::string name;
+            int queue_depth;
+            double latency_ms;    // Processing time of the last frame
+        };
+
+        /**
+         * Timed operations, recorded on every frame into lock-free histograms.
+         */
+        enum Timing {
+            READ = 0,           // Bundle read
+            GAMMA,
+            EXPOSURE,           // Exposure compensation
+            EXPOSURE_UPDATE,    // Gain re-estimation, inline or in the background
+            SEAM_UPDATE,        // Seam re-estimation, inline or in the background
+            BLEND,
+            OUTPUT,             // Mosaic publication, recorded by the caller with record_timing()
+            NR_TIMINGS
+        };
+
+        /**
+         * Snapshot of the timing histograms of the stitcher and of its cameras.
+         */
+        class TimingStats {
+        public:
+            class CameraTimings {
+            public:
+                std::string name;
+                LatencySummary read;
+                LatencySummary decode;
+                LatencySummary remap;
+            };
+
+            std::vector<std::pair<std::string, LatencySummary>> stages;
+            std::vector<CameraTimings> cameras;
+
+            nlohmann::json to_json() const;
+        };
+
+        ~Stitcher();
+
         /**
          * Initialize Stitching using a given vector of calibration images for each Camera Stream.
          * @param _src : vector of calibration images
@@ -97,16 +218,76 @@ namespace laz {
 
         /**
          * Read from Camera Stream and stitch the stream.
-         * @return Stitched mosaic
+         * @param _dst : stitched mosaic. When it is already allocated with the blender output size and type,
+         * possibly as an ROI of a larger buffer, the mosaic is blended into it in place.
          */
         bool read(cv::OutputArray _dst,
                   const bool& _do_update_exposure=false,
                   const bool& _do_update_seams=false);
 
+        /**
+         * Read from Camera Stream and stitch the stream into the next slot of a shared memory ring, then publish it.
+         * The mosaic is blended in place in the slot, except in pipelined mode where it is copied.
+         */
+        bool read(ShmRingWriter& _ring,
+                  const bool& _do_update_exposure=false,
+                  const bool& _do_update_seams=false);
+
+        /**
+         * @return size of the stitched mosaic, once initialized
+         */
+        cv::Size get_mosaic_size() const;
+
+        std::vector<StageStats> get_stage_stats() const;
+
+        void record_timing(const Timing& _timing, const double& _ms);
+
+        TimingStats get_timing_stats() const;
+
+        void reset_timing_stats();
+
     private:
-        Stitcher(const StitcherComponents& _components);
+        Stitcher(const StitcherComponents& _components, const StitcherOptions& _options);
+
+        bool capture(Frame& _frame);
+        void correct(Frame& _frame, const bool& _do_update_exposure, const bool& _do_update_seams);
+        void blend(Frame& _frame, cv::OutputArray _dst);
+
+        void start_pipeline();
+        void stop_pipeline();
+        void run_capture_stage();
+        void run_correct_stage();
+        void run_blend_stage();
+        void set_pipeline_error(const std::exception_ptr& _error);
+
+        bool swap_ready_seams();
+        void launch_seam_update(const std::vector<cv::Mat>& _src);
+        void update_exposure(const std::vector<cv::Mat>& _src);
 
         StitcherComponents m_components;
+        StitcherOptions m_options;
+        BundleGeometryPtr m_geometry;
+        std::vector<cv::Mat> m_seam_masks;
+
+        std::unique_ptr<ThreadPool> m_seam_worker;
+        std::future<std::vector<cv::Mat>> m_pending_seams;
+
+        long m_frame_idx;
+        std::unique_ptr<ThreadPool> m_exposure_worker;
+        std::future<void> m_pending_exposure;
+
+        Frame m_frame;    // Frame of the sequential read(), reusing the storage of its bundle from frame to frame
+
+        std::array<std::atomic<double>, NR_STAGES> m_stage_latencies;
+        std::array<LatencyHistogram, NR_TIMINGS> m_timings;
+        std::unique_ptr<BoundedQueue<Frame>> m_captured_queue;
+        std::unique_ptr<BoundedQueue<Frame>> m_corrected_queue;
+        std::unique_ptr<BoundedQueue<Frame>> m_blended_queue;
+        std::vector<std::thread> m_pipeline_threads;
+        std::atomic<bool> m_do_update_exposure;
+        std::atomic<bool> m_do_update_seams;
+        std::mutex m_pipeline_error_mutex;
+        std::exception_ptr m_pipeline_error;
     };
 } // namespace laz
 
@@ -1,24 +1,155 @@
 #include "stitching/blender.h"
+#include "core/parallel.h"
 #include "cmath"
+#include <opencv2/core/utility.hpp>
+#include <opencv2/core/hal/intrin.hpp>
+#include <opencv2/imgproc.hpp>
 
 namespace laz {
 
+    /**
+     * Blend width of a mosaic, following the CvBlender convention. Throws if it falls below one pixel.
+     */
+    static float get_static_blend_width(const cv::Rect& _dst_roi, const float& _blend_strength)
+    {
+        const float blend_width = std::sqrt(static_cast<float>(_dst_roi.area())) * _blend_strength / 100.f;
+        if (not (blend_width >= 1.f)){
+            std::string msg = "Error: blend width is below 1.0: " + std::to_string(blend_width) + "\n";
+            PLOGE << msg;
+            throw std::runtime_error(msg);
+        }
+        return blend_width;
+    }
+
+    /**
+     * _acc += _src * _weights, with _src CV_8UC3 and _weights, _acc CV_16UC3 of the same size.
+     */
+    static void accumulate_q8(const cv::Mat& _src, const cv::Mat& _weights, cv::Mat& _acc)
+    {
+        parallel_for_ref(cv::Range(0, _src.rows), [&](const cv::Range& range) {
+            const int len = _src.cols * _src.channels();
+            for (int i = range.start; i < range.end; i++)
+            {
+                const uchar* src = _src.ptr<uchar>(i);
+                const ushort* weights = _weights.ptr<ushort>(i);
+                ushort* acc = _acc.ptr<ushort>(i);
+                int j = 0;
+#if CV_SIMD
+                const int nlanes = cv::v_uint16::nlanes;
+                for (; j <= len - nlanes; j += nlanes)
+                {
+                    const cv::v_uint16 v_src = cv::vx_load_expand(src + j);
+                    const cv::v_uint16 v_weights = cv::vx_load(weights + j);
+                    cv::v_store(acc + j, cv::vx_load(acc + j) + cv::v_mul_wrap(v_src, v_weights));
+                }
+#endif
+                for (; j < len; j++)
+                    acc[j] = static_cast<ushort>(acc[j] + src[j] * weights[j]);
+            }
+        });
+    }
+
+    /**
+     * _dst = round(_acc / 256), with _acc CV_16UC3 and _dst CV_8UC3 of the same size.
+     */
+    static void normalize_q8(const cv::Mat& _acc, cv::Mat& _dst)
+    {
+        parallel_for_ref(cv::Range(0, _acc.rows), [&](const cv::Range& range) {
+            const int len = _acc.cols * _acc.channels();
+            for (int i = range.start; i < range.end; i++)
+            {
+                const ushort* acc = _acc.ptr<ushort>(i);
+                uchar* dst = _dst.ptr<uchar>(i);
+                int j = 0;
+#if CV_SIMD
+                const int nlanes = cv::v_uint8::nlanes;
+                for (; j <= len - nlanes; j += nlanes)
+                {
+                    const cv::v_uint16 v_low = cv::vx_load(acc + j);
+                    const cv::v_uint16 v_high = cv::vx_load(acc + j + cv::v_uint16::nlanes);
+                    cv::v_store(dst + j, cv::v_rshr_pack<8>(v_low, v_high));
+                }
+#endif
+                for (; j < len; j++)
+                    dst[j] = cv::saturate_cast<uchar>((acc[j] + 128) >> 8);
+            }
+        });
+    }
+
+    /**
+     * _dst += short(_src * _weight) per channel, as cv::detail::FeatherBlender::feed, with _src CV_8UC3 or
+     * CV_16SC3, _weight CV_32F and _dst CV_16SC3 of the same size.
+     */
+    template <typename T>
+    static void accumulate_feather(const cv::Mat& _src, const cv::Mat& _weight, cv::Mat& _dst)
+    {
+        parallel_for_ref(cv::Range(0, _src.rows), [&](const cv::Range& range) {
+            for (int i = range.start; i < range.end; i++)
+            {
+                const T* src = _src.ptr<T>(i);
+                const float* weight = _weight.ptr<float>(i);
+                short* dst = _dst.ptr<short>(i);
+                for (int j = 0; j < _src.cols; j++, src += 3, dst += 3)
+                {
+                    const float w = weight[j];
+                    dst[0] = static_cast<short>(dst[0] + static_cast<short>(src[0] * w));
+                    dst[1] = static_cast<short>(dst[1] + static_cast<short>(src[1] * w));
+                    dst[2] = static_cast<short>(dst[2] + static_cast<short>(src[2] * w));
+                }
+            }
+        });
+    }
+
+    /**
+     * _dst /= _weight_sum + eps, and 0 where no camera contributes, as cv::detail::FeatherBlender::blend.
+     */
+    static void normalize_feather(const cv::Mat& _weight_sum, cv::Mat& _dst)
+    {
+        static const float weight_eps = 1e-5f;
+        parallel_for_ref(cv::Range(0, _dst.rows), [&](const cv::Range& range) {
+            for (int i = range.start; i < range.end; i++)
+            {
+                const float* weight_sum = _weight_sum.ptr<float>(i);
+                short* dst = _dst.ptr<short>(i);
+                for (int j = 0; j < _dst.cols; j++, dst += 3)
+                {
+                    const float w = weight_sum[j];
+                    if (w > weight_eps)
+                    {
+                        const float norm = w + weight_eps;
+                        dst[0] = static_cast<short>(dst[0] / norm);
+                        dst[1] = static_cast<short>(dst[1] / norm);
+                        dst[2] = static_cast<short>(dst[2] / norm);
+                    }
+                    else
+                        dst[0] = dst[1] = dst[2] = 0;
+                }
+            }
+        });
+    }
+
+    cv::Size Blender::output_size() const
+    {
+        assert(m_geometry);
+        return cv::detail::resultRoi(m_geometry->get_tl_point_bundle(), m_geometry->get_size_bundle()).size();
+    }
+
     void Blender::update_masks(const std::vector <cv::Mat> &_mask_bundle)
     {
-        m_mask_bundle = _mask_bundle;
+        assert(m_geometry);
+        m_geometry = m_geometry->with_masks(_mask_bundle);
     }
 
     void Blender::update_corners(const std::vector <cv::Rect>& _corners_bundle)
     {
-        std::vector<cv::Point> tl_point_bundle(_corners_bundle.size());
-        for (int i = 0; i < tl_point_bundle.size(); i++)
-            tl_point_bundle[i] = _corners_bundle.at(i).tl();
-        m_tl_point_bundle = tl_point_bundle;
+        assert(m_geometry);
+        m_geometry = m_geometry->with_corners(_corners_bundle);
     }
 
     void Blender::update_sizes(const std::vector <cv::Size>& _size_bundle)
     {
-        m_size_bundle = _size_bundle;
+        assert(m_geometry);
+        m_geometry = m_geometry->with_sizes(_size_bundle);
     }
 
     CvBlender::CvBlender(const float& _blend_strength) : m_blender(nullptr)
@@ -33,46 +164,128 @@ namespace laz {
 
     float CvBlender::get_blend_width(const float& _blend_strength)
     {
-        cv::Size dst_sz = cv::detail::resultRoi(m_tl_point_bundle, m_size_bundle).size();
+        std::vector<cv::Point> tl_point_bundle;
+        std::vector<cv::Size> size_bundle;
+        if (m_geometry)
+        {
+            tl_point_bundle = m_geometry->get_tl_point_bundle();
+            size_bundle = m_geometry->get_size_bundle();
+        }
+        cv::Size dst_sz = cv::detail::resultRoi(tl_point_bundle, size_bundle).size();
         return std::sqrt(static_cast<float>(dst_sz.area())) * _blend_strength / 100.f;
     }
 
-    void CvBlender::init(const std::vector <cv::Mat>& _mask_bundle,
-                         const std::vector <cv::Rect>& _corners_bundle,
-                         const std::vector <cv::Size>& _size_bundle)
+    void CvBlender::init(const BundleGeometryPtr& _geometry)
     {
-        std::vector<cv::Point> tl_point_bundle(_corners_bundle.size());
-        for (int i = 0; i < tl_point_bundle.size(); i++)
-            tl_point_bundle[i] = _corners_bundle.at(i).tl();
-
-        m_mask_bundle = _mask_bundle;
-        m_tl_point_bundle = tl_point_bundle;
-        m_size_bundle = _size_bundle;
+        m_geometry = _geometry;
     }
 
     void CvBlender::blend(const std::vector <cv::Mat>& _images_bundle, cv::OutputArray _dst)
     {
-        assert( _images_bundle.size() == m_mask_bundle.size() );
-        assert( _images_bundle.size() == m_tl_point_bundle.size() );
+        assert(m_geometry);
+        assert( _images_bundle.size() == m_geometry->size() );
         assert(m_blender);
 
-        m_blender->prepare(m_tl_point_bundle, m_size_bundle);
+        const std::vector<cv::Mat>& mask_bundle = m_geometry->get_mask_bundle();
+        const std::vector<cv::Point>& tl_point_bundle = m_geometry->get_tl_point_bundle();
+        m_blender->prepare(tl_point_bundle, m_geometry->get_size_bundle());
 
+        m_image_s_bundle.resize(_images_bundle.size());
         for (int i=0; i< _images_bundle.size(); i++)
         {
-            cv::Mat img_warped_s ;
-            _images_bundle.at(i).convertTo(img_warped_s, CV_16S);
-            m_blender->feed(img_warped_s, m_mask_bundle[i], m_tl_point_bundle[i]);
+            _images_bundle.at(i).convertTo(m_image_s_bundle[i], CV_16S);
+            m_blender->feed(m_image_s_bundle[i], mask_bundle[i], tl_point_bundle[i]);
         }
         cv::Mat mosaic, mosaic_mask;
         m_blender->blend(mosaic, mosaic_mask);
-        _dst.assign(mosaic);
+        if (_dst.empty())
+            _dst.assign(mosaic);
+        else
+            mosaic.copyTo(_dst);
     }
 
     CvBlenderFeather::CvBlenderFeather(const float& _blend_strength) : CvBlender(_blend_strength) {
+        m_sharpness = 1.f/m_blend_width;
         m_blender = cv::detail::Blender::createDefault(cv::detail::Blender::FEATHER, false);
         cv::detail::FeatherBlender* fb = dynamic_cast<cv::detail::FeatherBlender*>(m_blender.get());
-        fb->setSharpness(1.f/m_blend_width);
+        fb->setSharpness(m_sharpness);
+    }
+
+    void CvBlenderFeather::init(const BundleGeometryPtr& _geometry)
+    {
+        m_geometry = _geometry;
+        this->prepare_weights();
+    }
+
+    void CvBlenderFeather::update_masks(const std::vector <cv::Mat>& _mask_bundle)
+    {
+        Blender::update_masks(_mask_bundle);
+        this->prepare_weights();
+    }
+
+    void CvBlenderFeather::update_corners(const std::vector <cv::Rect>& _corners_bundle)
+    {
+        Blender::update_corners(_corners_bundle);
+        this->prepare_weights();
+    }
+
+    void CvBlenderFeather::update_sizes(const std::vector <cv::Size>& _size_bundle)
+    {
+        Blender::update_sizes(_size_bundle);
+        this->prepare_weights();
+    }
+
+    void CvBlenderFeather::prepare_weights()
+    {
+        assert(m_geometry);
+        if (m_prepared_geometry && m_prepared_geometry->same_as(*m_geometry))
+            return;
+
+        const std::vector<cv::Mat>& mask_bundle = m_geometry->get_mask_bundle();
+        const std::vector<cv::Point>& tl_point_bundle = m_geometry->get_tl_point_bundle();
+        const std::vector<cv::Size>& size_bundle = m_geometry->get_size_bundle();
+        const int nr_cams = m_geometry->size();
+
+        m_dst_roi = cv::detail::resultRoi(tl_point_bundle, size_bundle);
+        m_weight_sum = cv::Mat::zeros(m_dst_roi.size(), CV_32F);
+        m_roi_bundle.resize(nr_cams);
+        m_weight_bundle.resize(nr_cams);
+        for (int i = 0; i < nr_cams; i++)
+        {
+            assert(mask_bundle[i].size() == size_bundle[i]);
+            m_roi_bundle[i] = cv::Rect(tl_point_bundle[i] - m_dst_roi.tl(), size_bundle[i]);
+            cv::detail::createWeightMap(mask_bundle[i], m_sharpness, m_weight_bundle[i]);
+            cv::Mat weight_sum_roi = m_weight_sum(m_roi_bundle[i]);
+            weight_sum_roi += m_weight_bundle[i];
+        }
+        m_prepared_geometry = m_geometry;
+    }
+
+    void CvBlenderFeather::blend(const std::vector <cv::Mat>& _images_bundle, cv::OutputArray _dst)
+    {
+        assert(m_geometry);
+        assert( _images_bundle.size() == m_roi_bundle.size() );
+
+        _dst.create(m_dst_roi.size(), CV_16SC3);
+        cv::Mat dst = _dst.getMat();
+        dst.setTo(cv::Scalar::all(0));
+
+        for (int i = 0; i < _images_bundle.size(); i++)
+        {
+            const cv::Mat& img = _images_bundle[i];
+            assert(img.size() == m_roi_bundle[i].size());
+            cv::Mat dst_roi = dst(m_roi_bundle[i]);
+            if (img.type() == CV_8UC3)
+                accumulate_feather<uchar>(img, m_weight_bundle[i], dst_roi);
+            else if (img.type() == CV_16SC3)
+                accumulate_feather<short>(img, m_weight_bundle[i], dst_roi);
+            else{
+                std::string msg = "Error: unsupported image type for feather blending: " + std::to_string(img.type()) + "\n";
+                PLOGE << msg;
+                throw std::runtime_error(msg);
+            }
+        }
+        normalize_feather(m_weight_sum, dst);
     }
 
     CvBlenderMultiBand::CvBlenderMultiBand(const float& _blend_strength) : CvBlender(_blend_strength) {
@@ -81,4 +294,505 @@ namespace laz {
         mb->setNumBands(static_cast<int>(std::ceil(std::log(m_blend_width)/std::log(2.)) - 1.));
     }
 
+    CvBlenderStripes::CvBlenderStripes(const int& _blender_type,
+                                       const int& _nr_stripes,
+                                       const float& _blend_strength) :
+            m_blender_type(_blender_type),
+            m_nr_stripes(_nr_stripes),
+            m_blend_strength(_blend_strength),
+            m_blend_width(0.f)
+    {
+        if (m_blender_type != cv::detail::Blender::FEATHER && m_blender_type != cv::detail::Blender::MULTI_BAND){
+            std::string msg = "Error: unsupported stripes blender type: " + std::to_string(m_blender_type) + "\n";
+            PLOGE << msg;
+            throw std::runtime_error(msg);
+        }
+        assert(m_nr_stripes >= 0);
+    }
+
+    void CvBlenderStripes::init(const BundleGeometryPtr& _geometry)
+    {
+        m_geometry = _geometry;
+        this->prepare_stripes();
+    }
+
+    void CvBlenderStripes::update_masks(const std::vector <cv::Mat>& _mask_bundle)
+    {
+        Blender::update_masks(_mask_bundle);
+        this->prepare_stripes();
+    }
+
+    void CvBlenderStripes::update_corners(const std::vector <cv::Rect>& _corners_bundle)
+    {
+        Blender::update_corners(_corners_bundle);
+        this->prepare_stripes();
+    }
+
+    void CvBlenderStripes::update_sizes(const std::vector <cv::Size>& _size_bundle)
+    {
+        Blender::update_sizes(_size_bundle);
+        this->prepare_stripes();
+    }
+
+    int CvBlenderStripes::get_num_bands() const
+    {
+        return std::max(0, static_cast<int>(std::ceil(std::log2(m_blend_width))) - 1);
+    }
+
+    cv::Ptr<cv::detail::Blender> CvBlenderStripes::create_blender() const
+    {
+        cv::Ptr<cv::detail::Blender> blender = cv::detail::Blender::createDefault(m_blender_type, false);
+        if (m_blender_type == cv::detail::Blender::FEATHER)
+        {
+            cv::detail::FeatherBlender* fb = dynamic_cast<cv::detail::FeatherBlender*>(blender.get());
+            fb->setSharpness(this->get_sharpness());
+        }
+        else
+        {
+            cv::detail::MultiBandBlender* mb = dynamic_cast<cv::detail::MultiBandBlender*>(blender.get());
+            mb->setNumBands(this->get_num_bands());
+        }
+        return blender;
+    }
+
+    void CvBlenderStripes::prepare_stripes()
+    {
+        assert(m_geometry);
+        const std::vector<cv::Point>& tl_point_bundle = m_geometry->get_tl_point_bundle();
+        const std::vector<cv::Size>& size_bundle = m_geometry->get_size_bundle();
+
+        m_dst_roi = cv::detail::resultRoi(tl_point_bundle, size_bundle);
+        m_blend_width = get_static_blend_width(m_dst_roi, m_blend_strength);
+
+        // Halo covering the feather ramp
+        int halo = static_cast<int>(std::ceil(m_blend_width)) + 1;
+        int grid = 1;
+        if (m_blender_type == cv::detail::Blender::MULTI_BAND)
+        {
+            // MultiBandBlender aligns its pyramids on multiples of 1 << num_bands from the origin of its roi:
+            // stripes and halos cut on that grid from the mosaic origin share the pyramids of a single blender.
+            // The 5-tap pyramid kernels reach less than 4 << num_bands pixels down and back up the pyramid,
+            // the halo doubles it.
+            grid = 1 << this->get_num_bands();
+            halo = std::max(halo, 8 << this->get_num_bands());
+        }
+
+        // Stripes across the longest side: on a 360 mosaic each stripe only sees a few cameras
+        const bool vertical_cut = m_dst_roi.width >= m_dst_roi.height;
+        const int length = vertical_cut ? m_dst_roi.width : m_dst_roi.height;
+        const int nr_stripes = std::max(1, std::min(length / grid, m_nr_stripes > 0 ? m_nr_stripes : cv::getNumThreads()));
+
+        m_stripes.resize(nr_stripes);
+        for (int s = 0; s < nr_stripes; s++)
+        {
+            Stripe& stripe = m_stripes[s];
+            const int start = (s * length / nr_stripes) / grid * grid;
+            const int end = s + 1 == nr_stripes ? length : ((s + 1) * length / nr_stripes) / grid * grid;
+            if (vertical_cut)
+            {
+                stripe.core = cv::Rect(m_dst_roi.x + start, m_dst_roi.y, end - start, m_dst_roi.height);
+                stripe.roi = cv::Rect(stripe.core.x - halo, stripe.core.y, stripe.core.width + 2 * halo, stripe.core.height);
+            }
+            else
+            {
+                stripe.core = cv::Rect(m_dst_roi.x, m_dst_roi.y + start, m_dst_roi.width, end - start);
+                stripe.roi = cv::Rect(stripe.core.x, stripe.core.y - halo, stripe.core.width, stripe.core.height + 2 * halo);
+            }
+            stripe.roi &= m_dst_roi;
+
+            stripe.cam_indices.clear();
+            for (int i = 0; i < m_geometry->size(); i++)
+                if (!(cv::Rect(tl_point_bundle[i], size_bundle[i]) & stripe.roi).empty())
+                    stripe.cam_indices.push_back(i);
+            stripe.blender = this->create_blender();
+        }
+        PLOGI << "Blending by " << nr_stripes << " stripes with a halo of " << halo << " pixels.";
+    }
+
+    void CvBlenderStripes::blend(const std::vector <cv::Mat>& _images_bundle, cv::OutputArray _dst)
+    {
+        assert(m_geometry);
+        assert( _images_bundle.size() == m_geometry->size() );
+
+        const std::vector<cv::Mat>& mask_bundle = m_geometry->get_mask_bundle();
+        const std::vector<cv::Point>& tl_point_bundle = m_geometry->get_tl_point_bundle();
+        const std::vector<cv::Size>& size_bundle = m_geometry->get_size_bundle();
+
+        _dst.create(m_dst_roi.size(), CV_16SC3);
+        cv::Mat dst = _dst.getMat();
+        dst.setTo(cv::Scalar::all(0));
+
+        parallel_for_ref(cv::Range(0, m_stripes.size()), [&](const cv::Range& range) {
+            for (int s = range.start; s < range.end; s++)
+            {
+                Stripe& stripe = m_stripes[s];
+                if (stripe.cam_indices.empty())
+                    continue;
+
+                stripe.blender->prepare(stripe.roi);
+                for (const int& i : stripe.cam_indices)
+                {
+                    const cv::Rect intersection = cv::Rect(tl_point_bundle[i], size_bundle[i]) & stripe.roi;
+                    const cv::Rect local_roi = intersection - tl_point_bundle[i];
+                    cv::Mat img_warped_s;
+                    _images_bundle.at(i)(local_roi).convertTo(img_warped_s, CV_16S);
+                    stripe.blender->feed(img_warped_s, mask_bundle[i](local_roi), intersection.tl());
+                }
+                cv::Mat mosaic, mosaic_mask;
+                stripe.blender->blend(mosaic, mosaic_mask);
+                mosaic(stripe.core - stripe.roi.tl()).copyTo(dst(stripe.core - m_dst_roi.tl()));
+            }
+        });
+    }
+
+    BlenderStaticFeather::BlenderStaticFeather(const float& _blend_strength) : m_blend_strength(_blend_strength)
+    {
+        if (not (m_blend_strength > 0.f)){
+            std::string msg = "Error: blend strength must be positive: " + std::to_string(m_blend_strength) + "\n";
+            PLOGE << msg;
+            throw std::runtime_error(msg);
+        }
+    }
+
+    void BlenderStaticFeather::init(const BundleGeometryPtr& _geometry)
+    {
+        m_geometry = _geometry;
+        this->prepare_weights();
+    }
+
+    void BlenderStaticFeather::update_masks(const std::vector <cv::Mat>& _mask_bundle)
+    {
+        Blender::update_masks(_mask_bundle);
+        this->prepare_weights();
+    }
+
+    void BlenderStaticFeather::update_corners(const std::vector <cv::Rect>& _corners_bundle)
+    {
+        Blender::update_corners(_corners_bundle);
+        this->prepare_weights();
+    }
+
+    void BlenderStaticFeather::update_sizes(const std::vector <cv::Size>& _size_bundle)
+    {
+        Blender::update_sizes(_size_bundle);
+        this->prepare_weights();
+    }
+
+    void BlenderStaticFeather::prepare_weights()
+    {
+        assert(m_geometry);
+        if (m_prepared_geometry && m_prepared_geometry->same_as(*m_geometry))
+            return;
+
+        const std::vector<cv::Mat>& mask_bundle = m_geometry->get_mask_bundle();
+        const std::vector<cv::Point>& tl_point_bundle = m_geometry->get_tl_point_bundle();
+        const std::vector<cv::Size>& size_bundle = m_geometry->get_size_bundle();
+        const int nr_cams = m_geometry->size();
+
+        m_dst_roi = cv::detail::resultRoi(tl_point_bundle, size_bundle);
+        const float blend_width = get_static_blend_width(m_dst_roi, m_blend_strength);
+
+        PLOGI << "Computing static feather weights...";
+
+        // Coverage count and feather weight sum over the mosaic
+        cv::Mat coverage = cv::Mat::zeros(m_dst_roi.size(), CV_8U);
+        cv::Mat weight_sum = cv::Mat::zeros(m_dst_roi.size(), CV_32F);
+        std::vector<cv::Mat> weight_bundle(nr_cams);
+        m_roi_bundle.resize(nr_cams);
+        for (int i = 0; i < nr_cams; i++)
+        {
+            assert(mask_bundle[i].type() == CV_8U);
+            assert(mask_bundle[i].size() == size_bundle[i]);
+            m_roi_bundle[i] = cv::Rect(tl_point_bundle[i] - m_dst_roi.tl(), size_bundle[i]);
+
+            cv::detail::createWeightMap(mask_bundle[i], 1.f / blend_width, weight_bundle[i]);
+            cv::Mat coverage_roi = coverage(m_roi_bundle[i]);
+            cv::add(coverage_roi, cv::Scalar(1), coverage_roi, mask_bundle[i]);
+            cv::Mat weight_sum_roi = weight_sum(m_roi_bundle[i]);
+            weight_sum_roi += weight_bundle[i];
+        }
+        cv::compare(coverage, 1, m_overlap_mask, cv::CMP_GT);
+
+        // Solo masks and quantized overlap weights. Weights are quantized from the cumulative sum so that
+        // the contributions of every overlap pixel add up to exactly 256.
+        cv::Mat cumulative_weight = cv::Mat::zeros(m_dst_roi.size(), CV_32F);
+        m_solo_mask_bundle.resize(nr_cams);
+        m_overlap_roi_bundle.resize(nr_cams);
+        m_overlap_weight_bundle.resize(nr_cams);
+        for (int i = 0; i < nr_cams; i++)
+        {
+            const cv::Rect& roi = m_roi_bundle[i];
+            m_solo_mask_bundle[i] = mask_bundle[i] & (coverage(roi) == 1);
+
+            cv::Mat overlap = mask_bundle[i] & m_overlap_mask(roi);
+            m_overlap_roi_bundle[i] = cv::boundingRect(overlap);
+            if (m_overlap_roi_bundle[i].empty())
+            {
+                m_overlap_weight_bundle[i].release();
+                continue;
+            }
+            const cv::Rect& overlap_roi = m_overlap_roi_bundle[i];
+            const cv::Rect dst_overlap_roi = overlap_roi + roi.tl();
+
+            cv::Mat normalized_weight;
+            cv::divide(weight_bundle[i](overlap_roi), weight_sum(dst_overlap_roi), normalized_weight);
+            normalized_weight.setTo(0.f, overlap(overlap_roi) == 0);
+
+            cv::Mat previous = cumulative_weight(dst_overlap_roi);
+            cv::Mat current = previous + normalized_weight;
+            cv::Mat previous_q8, current_q8, weight_q8;
+            previous.convertTo(previous_q8, CV_32S, 256.);
+            current.convertTo(current_q8, CV_32S, 256.);
+            cv::Mat(current_q8 - previous_q8).convertTo(weight_q8, CV_16U);
+            current.copyTo(previous);
+
+            cv::merge(std::vector<cv::Mat>(3, weight_q8), m_overlap_weight_bundle[i]);
+        }
+
+        m_accumulator.create(m_dst_roi.size(), CV_16UC3);
+        m_overlap_buffer.create(m_dst_roi.size(), CV_8UC3);
+        m_prepared_geometry = m_geometry;
+        PLOGI << "Computing static feather weights SUCCESS";
+    }
+
+    void BlenderStaticFeather::blend(const std::vector <cv::Mat>& _images_bundle, cv::OutputArray _dst)
+    {
+        assert(m_geometry);
+        assert( _images_bundle.size() == m_roi_bundle.size() );
+
+        _dst.create(m_dst_roi.size(), CV_8UC3);
+        cv::Mat dst = _dst.getMat();
+        dst.setTo(cv::Scalar::all(0));
+
+        // Non-overlapping regions are copied directly
+        for (int i = 0; i < _images_bundle.size(); i++)
+        {
+            assert(_images_bundle[i].type() == CV_8UC3);
+            assert(_images_bundle[i].size() == m_roi_bundle[i].size());
+            _images_bundle[i].copyTo(dst(m_roi_bundle[i]), m_solo_mask_bundle[i]);
+        }
+
+        // Weighted accumulation over the overlap regions only
+        for (int i = 0; i < _images_bundle.size(); i++)
+            if (!m_overlap_roi_bundle[i].empty())
+                m_accumulator(m_overlap_roi_bundle[i] + m_roi_bundle[i].tl()).setTo(cv::Scalar::all(0));
+
+        for (int i = 0; i < _images_bundle.size(); i++)
+        {
+            if (m_overlap_roi_bundle[i].empty())
+                continue;
+            cv::Mat acc = m_accumulator(m_overlap_roi_bundle[i] + m_roi_bundle[i].tl());
+            accumulate_q8(_images_bundle[i](m_overlap_roi_bundle[i]), m_overlap_weight_bundle[i], acc);
+        }
+
+        for (int i = 0; i < _images_bundle.size(); i++)
+        {
+            if (m_overlap_roi_bundle[i].empty())
+                continue;
+            const cv::Rect dst_overlap_roi = m_overlap_roi_bundle[i] + m_roi_bundle[i].tl();
+            cv::Mat buffer = m_overlap_buffer(dst_overlap_roi);
+            normalize_q8(m_accumulator(dst_overlap_roi), buffer);
+            buffer.copyTo(dst(dst_overlap_roi), m_overlap_mask(dst_overlap_roi));
+        }
+    }
+
+    BlenderStaticMultiBand::BlenderStaticMultiBand(const float& _blend_strength) :
+            m_blend_strength(_blend_strength),
+            m_nr_bands(0)
+    {
+        if (not (m_blend_strength > 0.f)){
+            std::string msg = "Error: blend strength must be positive: " + std::to_string(m_blend_strength) + "\n";
+            PLOGE << msg;
+            throw std::runtime_error(msg);
+        }
+    }
+
+    void BlenderStaticMultiBand::init(const BundleGeometryPtr& _geometry)
+    {
+        m_geometry = _geometry;
+        this->prepare_pyramids();
+    }
+
+    void BlenderStaticMultiBand::update_masks(const std::vector <cv::Mat>& _mask_bundle)
+    {
+        Blender::update_masks(_mask_bundle);
+        this->prepare_pyramids();
+    }
+
+    void BlenderStaticMultiBand::update_corners(const std::vector <cv::Rect>& _corners_bundle)
+    {
+        Blender::update_corners(_corners_bundle);
+        this->prepare_pyramids();
+    }
+
+    void BlenderStaticMultiBand::update_sizes(const std::vector <cv::Size>& _size_bundle)
+    {
+        Blender::update_sizes(_size_bundle);
+        this->prepare_pyramids();
+    }
+
+    void BlenderStaticMultiBand::prepare_pyramids()
+    {
+        static const float weight_eps = 1e-5f;
+
+        assert(m_geometry);
+        if (m_prepared_geometry && m_prepared_geometry->same_as(*m_geometry))
+            return;
+
+        const std::vector<cv::Mat>& mask_bundle = m_geometry->get_mask_bundle();
+        const std::vector<cv::Point>& tl_point_bundle = m_geometry->get_tl_point_bundle();
+        const std::vector<cv::Size>& size_bundle = m_geometry->get_size_bundle();
+        const int nr_cams = m_geometry->size();
+
+        // Same band count as CvBlenderMultiBand, cropped to the mosaic size like cv::detail::MultiBandBlender
+        m_dst_roi_final = cv::detail::resultRoi(tl_point_bundle, size_bundle);
+        const float blend_width = get_static_blend_width(m_dst_roi_final, m_blend_strength);
+        const double max_len = std::max(m_dst_roi_final.width, m_dst_roi_final.height);
+        m_nr_bands = std::min(std::max(0, static_cast<int>(std::ceil(std::log2(blend_width))) - 1),
+                              static_cast<int>(std::ceil(std::log2(max_len))));
+        const int align = 1 << m_nr_bands;
+
+        PLOGI << "Building static multi-band pyramids (" << m_nr_bands << " bands)...";
+
+        // Pad the mosaic so that every level is exactly half of the previous one
+        m_dst_roi = m_dst_roi_final;
+        m_dst_roi.width += (align - m_dst_roi.width % align) % align;
+        m_dst_roi.height += (align - m_dst_roi.height % align) % align;
+
+        m_dst_pyr.resize(m_nr_bands + 1);
+        m_dst_up_pyr.resize(m_nr_bands);
+        std::vector<cv::Mat> band_weight_sum(m_nr_bands + 1);
+        for (int l = 0; l <= m_nr_bands; l++)
+        {
+            const cv::Size level_size(m_dst_roi.width >> l, m_dst_roi.height >> l);
+            m_dst_pyr[l].create(level_size, CV_32FC3);
+            if (l < m_nr_bands)
+                m_dst_up_pyr[l].create(level_size, CV_32FC3);
+            band_weight_sum[l] = cv::Mat::zeros(level_size, CV_32F);
+        }
+
+        // Padded camera areas, aligned on the mosaic grid, and their raw weight pyramids
+        const int gap = 3 * align;
+        m_roi_bundle.resize(nr_cams);
+        m_border_bundle.resize(nr_cams);
+        m_weight_pyr_bundle.resize(nr_cams);
+        for (int i = 0; i < nr_cams; i++)
+        {
+            const cv::Point& tl = tl_point_bundle[i];
+            const cv::Size& size = size_bundle[i];
+            assert(mask_bundle[i].type() == CV_8U);
+            assert(mask_bundle[i].size() == size);
+
+            cv::Point tl_new(std::max(m_dst_roi.x, tl.x - gap), std::max(m_dst_roi.y, tl.y - gap));
+            cv::Point br_new(std::min(m_dst_roi.br().x, tl.x + size.width + gap),
+                             std::min(m_dst_roi.br().y, tl.y + size.height + gap));
+            tl_new.x = m_dst_roi.x + (((tl_new.x - m_dst_roi.x) >> m_nr_bands) << m_nr_bands);
+            tl_new.y = m_dst_roi.y + (((tl_new.y - m_dst_roi.y) >> m_nr_bands) << m_nr_bands);
+            int width = br_new.x - tl_new.x;
+            int height = br_new.y - tl_new.y;
+            width += (align - width % align) % align;
+            height += (align - height % align) % align;
+            br_new = tl_new + cv::Point(width, height);
+            const cv::Point shift(std::max(br_new.x - m_dst_roi.br().x, 0), std::max(br_new.y - m_dst_roi.br().y, 0));
+            tl_new -= shift;
+            br_new -= shift;
+
+            m_roi_bundle[i] = cv::Rect(tl_new - m_dst_roi.tl(), cv::Size(width, height));
+            m_border_bundle[i] = cv::Vec4i(tl.y - tl_new.y, br_new.y - tl.y - size.height,
+                                           tl.x - tl_new.x, br_new.x - tl.x - size.width);
+            const cv::Vec4i& border = m_border_bundle[i];
+
+            std::vector<cv::Mat>& weight_pyr = m_weight_pyr_bundle[i];
+            weight_pyr.resize(m_nr_bands + 1);
+            cv::Mat weight_map;
+            mask_bundle[i].convertTo(weight_map, CV_32F, 1./255.);
+            cv::copyMakeBorder(weight_map, weight_pyr[0], border[0], border[1], border[2], border[3],
+                               cv::BORDER_CONSTANT);
+            for (int l = 0; l < m_nr_bands; l++)
+                cv::pyrDown(weight_pyr[l], weight_pyr[l + 1]);
+
+            for (int l = 0; l <= m_nr_bands; l++)
+            {
+                const cv::Rect& roi = m_roi_bundle[i];
+                cv::Mat weight_sum_roi = band_weight_sum[l](cv::Rect(roi.x >> l, roi.y >> l, roi.width >> l, roi.height >> l));
+                weight_sum_roi += weight_pyr[l];
+            }
+        }
+        cv::compare(band_weight_sum[0](cv::Rect(cv::Point(), m_dst_roi_final.size())), weight_eps,
+                    m_dst_empty_mask, cv::CMP_LE);
+
+        // Normalize the weight pyramids once, and allocate the per-frame buffers
+        m_src_pyr_bundle.resize(nr_cams);
+        m_src_up_pyr_bundle.resize(nr_cams);
+        m_border_buffer_bundle.resize(nr_cams);
+        for (int l = 0; l <= m_nr_bands; l++)
+            band_weight_sum[l] += weight_eps;
+        for (int i = 0; i < nr_cams; i++)
+        {
+            const cv::Rect& roi = m_roi_bundle[i];
+            m_src_pyr_bundle[i].resize(m_nr_bands + 1);
+            m_src_up_pyr_bundle[i].resize(m_nr_bands);
+            m_border_buffer_bundle[i].create(roi.size(), CV_8UC3);
+            for (int l = 0; l <= m_nr_bands; l++)
+            {
+                const cv::Rect level_roi(roi.x >> l, roi.y >> l, roi.width >> l, roi.height >> l);
+                cv::Mat normalized_weight;
+                cv::divide(m_weight_pyr_bundle[i][l], band_weight_sum[l](level_roi), normalized_weight);
+                cv::merge(std::vector<cv::Mat>(3, normalized_weight), m_weight_pyr_bundle[i][l]);
+
+                m_src_pyr_bundle[i][l].create(level_roi.size(), CV_32FC3);
+                if (l < m_nr_bands)
+                    m_src_up_pyr_bundle[i][l].create(level_roi.size(), CV_32FC3);
+            }
+        }
+
+        m_prepared_geometry = m_geometry;
+        PLOGI << "Building static multi-band pyramids SUCCESS";
+    }
+
+    void BlenderStaticMultiBand::blend(const std::vector <cv::Mat>& _images_bundle, cv::OutputArray _dst)
+    {
+        assert(m_geometry);
+        assert( _images_bundle.size() == m_roi_bundle.size() );
+
+        for (auto& level : m_dst_pyr)
+            level.setTo(cv::Scalar::all(0));
+
+        // Laplacian pyramid of each camera, accumulated with the normalized weights
+        for (int i = 0; i < _images_bundle.size(); i++)
+        {
+            assert(_images_bundle[i].type() == CV_8UC3);
+            const cv::Vec4i& border = m_border_bundle[i];
+            std::vector<cv::Mat>& src_pyr = m_src_pyr_bundle[i];
+            std::vector<cv::Mat>& src_up_pyr = m_src_up_pyr_bundle[i];
+
+            cv::copyMakeBorder(_images_bundle[i], m_border_buffer_bundle[i], border[0], border[1], border[2], border[3],
+                               cv::BORDER_REFLECT);
+            m_border_buffer_bundle[i].convertTo(src_pyr[0], CV_32F);
+            for (int l = 0; l < m_nr_bands; l++)
+            {
+                cv::pyrDown(src_pyr[l], src_pyr[l + 1]);
+                cv::pyrUp(src_pyr[l + 1], src_up_pyr[l], src_pyr[l].size());
+                cv::subtract(src_pyr[l], src_up_pyr[l], src_pyr[l]);
+            }
+
+            const cv::Rect& roi = m_roi_bundle[i];
+            for (int l = 0; l <= m_nr_bands; l++)
+            {
+                cv::Mat dst_level = m_dst_pyr[l](cv::Rect(roi.x >> l, roi.y >> l, roi.width >> l, roi.height >> l));
+                cv::accumulateProduct(src_pyr[l], m_weight_pyr_bundle[i][l], dst_level);
+            }
+        }
+
+        // Collapse the mosaic pyramid
+        for (int l = m_nr_bands; l > 0; l--)
+        {
+            cv::pyrUp(m_dst_pyr[l], m_dst_up_pyr[l - 1], m_dst_pyr[l - 1].size());
+            cv::add(m_dst_pyr[l - 1], m_dst_up_pyr[l - 1], m_dst_pyr[l - 1]);
+        }
+
+        m_dst_pyr[0](cv::Rect(cv::Point(), m_dst_roi_final.size())).convertTo(_dst, CV_8U);
+        cv::Mat dst = _dst.getMat();
+        dst.setTo(cv::Scalar::all(0), m_dst_empty_mask);
+    }
 }
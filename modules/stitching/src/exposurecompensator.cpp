@@ -1,12 +1,86 @@
 #include "stitching/exposurecompensator.h"
+#include "core/parallel.h"
 #include "assert.h"
+#include <opencv2/core/utility.hpp>
+#include <opencv2/core/hal/intrin.hpp>
+#include <opencv2/imgproc.hpp>
 
 namespace laz {
-    void CvExposureCompensator::init(const std::vector <cv::Mat>& img_bundle,
-                                     const std::vector <cv::Mat>& mask_bundle,
-                                     const std::vector <cv::Rect>& corners_bundle) {
-        assert(img_bundle.size() == corners_bundle.size());
-        assert(img_bundle.size() == mask_bundle.size());
+
+    static const int gain_map_shift = 12;
+    static const uint8_t slot_mask = 0x3;
+    static const uint8_t new_gains_flag = 0x4;
+    static_assert(std::atomic<uint8_t>::is_always_lock_free, "Gains are published through a lock-free atomic byte");
+
+    /**
+     * _img = saturate(_img * _gains), with _img CV_8UC3 and _gains CV_16UC3 in Q12 fixed-point.
+     */
+    static void multiply_gains_q12(cv::Mat& _img, const cv::Mat& _gains)
+    {
+        parallel_for_ref(cv::Range(0, _img.rows), [&](const cv::Range& range) {
+            const int len = _img.cols * _img.channels();
+            for (int i = range.start; i < range.end; i++)
+            {
+                uchar* img = _img.ptr<uchar>(i);
+                const ushort* gains = _gains.ptr<ushort>(i);
+                int j = 0;
+#if CV_SIMD
+                const int nlanes = cv::v_uint8::nlanes;
+                for (; j <= len - nlanes; j += nlanes)
+                {
+                    cv::v_uint16 v_img0, v_img1;
+                    cv::v_expand(cv::vx_load(img + j), v_img0, v_img1);
+                    cv::v_uint32 v_prod0, v_prod1, v_prod2, v_prod3;
+                    cv::v_mul_expand(v_img0, cv::vx_load(gains + j), v_prod0, v_prod1);
+                    cv::v_mul_expand(v_img1, cv::vx_load(gains + j + cv::v_uint16::nlanes), v_prod2, v_prod3);
+                    cv::v_store(img + j, cv::v_pack(cv::v_rshr_pack<gain_map_shift>(v_prod0, v_prod1),
+                                                    cv::v_rshr_pack<gain_map_shift>(v_prod2, v_prod3)));
+                }
+#endif
+                for (; j < len; j++)
+                    img[j] = cv::saturate_cast<uchar>(
+                            (static_cast<unsigned>(img[j]) * gains[j] + (1u << (gain_map_shift - 1))) >> gain_map_shift);
+            }
+        });
+    }
+
+    void CvExposureCompensator::init(const std::vector <cv::Mat>& img_bundle, const BundleGeometryPtr& geometry) {
+        assert(geometry);
+        assert(img_bundle.size() == geometry->size());
+
+        m_geometry = geometry;
+        PLOGI << "Initializing exposition compensation...";
+        this->publish_gains(this->materialize_gains(this->estimate_gains(img_bundle)));
+        PLOGI << "Initializing exposition compensation SUCCESS";
+    }
+
+    void CvExposureCompensator::update(const std::vector <cv::Mat>& img_bundle) {
+        assert(m_geometry);
+        assert(img_bundle.size() == m_geometry->size());
+
+        std::vector<cv::Mat> raw_gain_bundle = this->estimate_gains(img_bundle);
+        if (m_raw_gain_bundle.size() == raw_gain_bundle.size() && m_smoothing < 1.f)
+        {
+            for (int i = 0; i < raw_gain_bundle.size(); i++)
+            {
+                const cv::Mat& previous_gain = m_raw_gain_bundle[i];
+                if (previous_gain.size() == raw_gain_bundle[i].size() && previous_gain.type() == raw_gain_bundle[i].type())
+                    cv::addWeighted(previous_gain, 1. - m_smoothing, raw_gain_bundle[i], m_smoothing, 0., raw_gain_bundle[i]);
+            }
+        }
+        this->publish_gains(this->materialize_gains(raw_gain_bundle));
+        PLOGD << "Updated exposition compensation gains.";
+    }
+
+    void CvExposureCompensator::set_smoothing(const float& _smoothing)
+    {
+        assert(_smoothing > 0.f and _smoothing <= 1.f);
+        m_smoothing = _smoothing;
+    }
+
+    std::vector<cv::Mat> CvExposureCompensator::estimate_gains(const std::vector <cv::Mat>& img_bundle)
+    {
+        const std::vector<cv::Mat>& mask_bundle = m_geometry->get_mask_bundle();
 
         std::vector<cv::UMat> img_Ubundle(mask_bundle.size());
         for (int i = 0; i < img_Ubundle.size(); i++)
@@ -16,26 +90,84 @@ namespace laz {
         for (int i = 0; i < mask_Ubundle.size(); i++)
             mask_Ubundle[i] = mask_bundle.at(i).getUMat(cv::ACCESS_FAST);
 
-        std::vector<cv::Point> tl_point_bundle(corners_bundle.size());
-        for (int i = 0; i < tl_point_bundle.size(); i++)
-            tl_point_bundle[i] = corners_bundle.at(i).tl();
+        m_compensator->feed(m_geometry->get_tl_point_bundle(), img_Ubundle, mask_Ubundle);
 
-        m_mask_bundle = mask_bundle;
-        m_tl_point_bundle = tl_point_bundle;
-        PLOGI << "Initializing exposition compensation...";
-        m_compensator->feed(tl_point_bundle, img_Ubundle, mask_Ubundle);
-        PLOGI << "Initializing exposition compensation SUCCESS";
+        std::vector<cv::Mat> raw_gain_bundle;
+        m_compensator->getMatGains(raw_gain_bundle);
+        assert(raw_gain_bundle.size() == mask_bundle.size());
+        return raw_gain_bundle;
+    }
+
+    CvExposureCompensator::GainBundle CvExposureCompensator::materialize_gains(
+            const std::vector <cv::Mat>& _raw_gain_bundle) const
+    {
+        const std::vector<cv::Size>& size_bundle = m_geometry->get_size_bundle();
+
+        GainBundle gains;
+        gains.raw_gain_bundle = _raw_gain_bundle;
+        gains.lut_bundle.assign(_raw_gain_bundle.size(), cv::Mat());
+        gains.map_bundle.assign(_raw_gain_bundle.size(), cv::Mat());
+        for (int i = 0; i < _raw_gain_bundle.size(); i++)
+        {
+            const cv::Mat& gain = _raw_gain_bundle[i];
+            if (gain.depth() == CV_64F)
+            {
+                // GAIN holds one gain, CHANNELS one gain per channel
+                cv::Mat lut(1, 256, CV_8UC3);
+                for (int c = 0; c < 3; c++)
+                {
+                    const double channel_gain = gain.at<double>(std::min(c, static_cast<int>(gain.total()) - 1));
+                    for (int v = 0; v < 256; v++)
+                        lut.at<cv::Vec3b>(v)[c] = cv::saturate_cast<uchar>(v * channel_gain);
+                }
+                gains.lut_bundle[i] = lut;
+            }
+            else
+            {
+                // Block gains: resized once here instead of on every frame
+                cv::Mat gain_map;
+                cv::resize(gain, gain_map, size_bundle[i], 0, 0, cv::INTER_LINEAR);
+                if (gain_map.channels() == 1)
+                    cv::merge(std::vector<cv::Mat>(3, gain_map), gain_map);
+                gain_map.convertTo(gains.map_bundle[i], CV_16U, 1 << gain_map_shift);
+            }
+        }
+        return gains;
+    }
+
+    void CvExposureCompensator::publish_gains(GainBundle&& _gains)
+    {
+        m_raw_gain_bundle = _gains.raw_gain_bundle;
+        m_gain_slots[m_back_slot] = std::move(_gains);
+        // Release: the slot content is visible to the thread acquiring its index
+        m_back_slot = m_published_slot.exchange(m_back_slot | new_gains_flag, std::memory_order_acq_rel) & slot_mask;
+    }
+
+    const CvExposureCompensator::GainBundle& CvExposureCompensator::acquire_gains() const
+    {
+        if (m_published_slot.load(std::memory_order_relaxed) & new_gains_flag)
+            m_front_slot = m_published_slot.exchange(m_front_slot, std::memory_order_acq_rel) & slot_mask;
+        return m_gain_slots[m_front_slot];
     }
 
     void CvExposureCompensator::apply(std::vector <cv::Mat>& _img_bundle) const
     {
-        assert( _img_bundle.size() == m_mask_bundle.size() );
-        assert( _img_bundle.size() == m_tl_point_bundle.size() );
-        PLOGI << "Applying exposition compensation.";
+        const GainBundle& gains = this->acquire_gains();
+        assert( _img_bundle.size() == gains.raw_gain_bundle.size() );
 
         // Compensate exposure
-        for (int i = 0; i < m_mask_bundle.size(); i++)
-            m_compensator->apply(i, m_tl_point_bundle[i], _img_bundle[i], m_mask_bundle[i]);
+        for (int i = 0; i < _img_bundle.size(); i++)
+        {
+            cv::Mat& img = _img_bundle[i];
+            assert(img.type() == CV_8UC3);
+            if (!gains.lut_bundle[i].empty())
+                cv::LUT(img, gains.lut_bundle[i], img);
+            else
+            {
+                assert(img.size() == gains.map_bundle[i].size());
+                multiply_gains_q12(img, gains.map_bundle[i]);
+            }
+        }
     }
 
     CvExposureCompensatorGain::CvExposureCompensatorGain(const int &nr_feeds) {
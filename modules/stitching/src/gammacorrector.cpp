@@ -1,5 +1,7 @@
 #include "stitching/gammacorrector.h"
+#include "core/parallel.h"
 #include "assert.h"
+#include <opencv2/core/utility.hpp>
 
 
 namespace laz {
@@ -8,24 +10,37 @@ namespace laz {
     {
         assert(m_alpha >= 1.f and m_alpha <= 3.f);
         assert(m_beta >= 0 and m_beta <= 100);
+
+        for (int i = 0; i < m_lut.size(); i++)
+            m_lut[i] = cv::saturate_cast<uchar>(m_alpha * i + m_beta);
     }
 
     void GammaCorrector::apply(std::vector <cv::Mat> &_img_bundle, const std::vector<cv::Mat>& _mask_bundle) 
     {
         assert(_img_bundle.size() == _mask_bundle.size());
 
-        PLOGI << "Applying gamma correction.";
         for (int i=0; i<_img_bundle.size();i++)
         {
-            auto& img = _img_bundle.at(i);
-            auto& mask = _mask_bundle.at(i);
-
-            cv::Mat mask_with_channels;
-            std::vector<cv::Mat> channels(img.channels());
-            for(int i=0;i<channels.size();i++) channels[i] = mask;
-            cv::merge(channels, mask_with_channels);
+            cv::Mat& img = _img_bundle.at(i);
+            const cv::Mat& mask = _mask_bundle.at(i);
+            assert(img.depth() == CV_8U);
+            assert(mask.type() == CV_8U && mask.size() == img.size());
 
-            cv::min(m_alpha * img + m_beta, mask_with_channels, img);
+            // LUT and mask fused in one pass: no merged mask nor expression temporaries
+            const int channels = img.channels();
+            parallel_for_ref(cv::Range(0, img.rows), [&](const cv::Range& range) {
+                for (int y = range.start; y < range.end; y++)
+                {
+                    uchar* pixel = img.ptr<uchar>(y);
+                    const uchar* mask_row = mask.ptr<uchar>(y);
+                    for (int x = 0; x < img.cols; x++, pixel += channels)
+                    {
+                        const uchar m = mask_row[x];
+                        for (int c = 0; c < channels; c++)
+                            pixel[c] = std::min(m_lut[pixel[c]], m);
+                    }
+                }
+            });
         }
     }
 }  //namespace laz
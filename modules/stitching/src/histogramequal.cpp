@@ -1,35 +1,203 @@
 #include "stitching/histogramequal.h"
+#include "core/parallel.h"
 #include "assert.h"
+#include <opencv2/core/utility.hpp>
 
 
 namespace laz {
 
+    /**
+     * Bilinear interpolation of the four tile LUTs surrounding a pixel.
+     */
+    static inline uchar interpolate_luts(const uchar* _luts_top, const uchar* _luts_bottom,
+                                         const int& _x_offset1, const int& _x_offset2,
+                                         const float& _xa, const float& _ya, const uchar& _value)
+    {
+        const float top = _luts_top[_x_offset1 + _value] * (1.f - _xa) + _luts_top[_x_offset2 + _value] * _xa;
+        const float bottom = _luts_bottom[_x_offset1 + _value] * (1.f - _xa) + _luts_bottom[_x_offset2 + _value] * _xa;
+        return cv::saturate_cast<uchar>(top * (1.f - _ya) + bottom * _ya);
+    }
+
+    void HistogramEqualizer::ClaheState::init(const cv::Size& _size, const cv::Size& _tile_grid)
+    {
+        size = _size;
+        luts.create(_tile_grid.area(), 256, CV_8U);
+
+        // Same interpolation coordinates as cv::CLAHE
+        const float inv_tw = static_cast<float>(_tile_grid.width) / _size.width;
+        x_offsets1.resize(_size.width);
+        x_offsets2.resize(_size.width);
+        x_weights.resize(_size.width);
+        for (int x = 0; x < _size.width; x++)
+        {
+            const float txf = x * inv_tw - 0.5f;
+            const int tx1 = cvFloor(txf);
+            x_weights[x] = txf - tx1;
+            x_offsets1[x] = std::max(tx1, 0) * 256;
+            x_offsets2[x] = std::min(tx1 + 1, _tile_grid.width - 1) * 256;
+        }
+
+        const float inv_th = static_cast<float>(_tile_grid.height) / _size.height;
+        y_tiles1.resize(_size.height);
+        y_tiles2.resize(_size.height);
+        y_weights.resize(_size.height);
+        for (int y = 0; y < _size.height; y++)
+        {
+            const float tyf = y * inv_th - 0.5f;
+            const int ty1 = cvFloor(tyf);
+            y_weights[y] = tyf - ty1;
+            y_tiles1[y] = std::max(ty1, 0);
+            y_tiles2[y] = std::min(ty1 + 1, _tile_grid.height - 1);
+        }
+    }
+
+    HistogramEqualizer::HistogramEqualizer(const EqualizationMode& _mode,
+                                           const float& _clip_limit,
+                                           const cv::Size& _tile_grid) :
+            m_mode(_mode),
+            m_clip_limit(_clip_limit),
+            m_tile_grid(_tile_grid)
+    {
+        assert(m_clip_limit > 0.f);
+        assert(m_tile_grid.width > 0 and m_tile_grid.height > 0);
+    }
+
+    void HistogramEqualizer::compute_luts(ClaheState& _state, const cv::Mat& _mask) const
+    {
+        const cv::Mat& plane = _state.plane;
+        parallel_for_ref(cv::Range(0, m_tile_grid.area()), [&](const cv::Range& range) {
+            for (int t = range.start; t < range.end; t++)
+            {
+                const int tx = t % m_tile_grid.width;
+                const int ty = t / m_tile_grid.width;
+                const int x_start = tx * plane.cols / m_tile_grid.width;
+                const int x_end = (tx + 1) * plane.cols / m_tile_grid.width;
+                const int y_start = ty * plane.rows / m_tile_grid.height;
+                const int y_end = (ty + 1) * plane.rows / m_tile_grid.height;
+
+                // Histogram of the masked pixels only
+                int hist[256] = {0};
+                int count = 0;
+                for (int y = y_start; y < y_end; y++)
+                {
+                    const uchar* plane_row = plane.ptr<uchar>(y);
+                    const uchar* mask_row = _mask.ptr<uchar>(y);
+                    for (int x = x_start; x < x_end; x++)
+                        if (mask_row[x])
+                        {
+                            hist[plane_row[x]]++;
+                            count++;
+                        }
+                }
+
+                uchar* lut = _state.luts.ptr<uchar>(t);
+                if (count == 0)
+                {
+                    for (int i = 0; i < 256; i++)
+                        lut[i] = static_cast<uchar>(i);
+                    continue;
+                }
+
+                // Clip the histogram and redistribute the excess, as cv::CLAHE does
+                const int clip_limit = std::max(1, static_cast<int>(m_clip_limit * count / 256));
+                int excess = 0;
+                for (int i = 0; i < 256; i++)
+                    if (hist[i] > clip_limit)
+                    {
+                        excess += hist[i] - clip_limit;
+                        hist[i] = clip_limit;
+                    }
+                const int batch = excess / 256;
+                int residual = excess - batch * 256;
+                for (int i = 0; i < 256; i++)
+                    hist[i] += batch;
+                if (residual > 0)
+                {
+                    const int step = std::max(256 / residual, 1);
+                    for (int i = 0; i < 256 && residual > 0; i += step, residual--)
+                        hist[i]++;
+                }
+
+                const float scale = 255.f / count;
+                int sum = 0;
+                for (int i = 0; i < 256; i++)
+                {
+                    sum += hist[i];
+                    lut[i] = cv::saturate_cast<uchar>(sum * scale);
+                }
+            }
+        });
+    }
+
     void HistogramEqualizer::apply(std::vector <cv::Mat> &_img_bundle, const std::vector <cv::Mat> &_mask_bundle)
     {
         assert(_img_bundle.size() == _mask_bundle.size());
 
         PLOGI << "Applying histogram equalization.";
+        m_state_bundle.resize(_img_bundle.size());
         for (int i = 0; i < _img_bundle.size(); i++) {
             auto &img = _img_bundle.at(i);
             auto &mask = _mask_bundle.at(i);
+            auto &state = m_state_bundle.at(i);
+            assert(img.type() == CV_8UC3);
+            assert(mask.type() == CV_8U && mask.size() == img.size());
 
-            cv::Mat lab_image;
-            cv::cvtColor(img, lab_image, cv::COLOR_BGR2Lab);
+            if (state.size != img.size())
+                state.init(img.size(), m_tile_grid);
 
-            // Extract the L channel
-            std::vector <cv::Mat> lab_planes(3);
-            cv::split(lab_image, lab_planes);  // now we have the L image in lab_planes[0]
+            const int grid_width = m_tile_grid.width;
+            if (m_mode == EqualizationMode::LAB)
+            {
+                cv::cvtColor(img, state.lab, cv::COLOR_BGR2Lab);
+                cv::extractChannel(state.lab, state.plane, 0);
+                this->compute_luts(state, mask);
 
-            // apply the CLAHE algorithm to the L channel
-            cv::Ptr <cv::CLAHE> clahe = cv::createCLAHE();
-            clahe->setClipLimit(4);
-            cv::Mat dst;
-            clahe->apply(lab_planes[0], dst);
+                parallel_for_ref(cv::Range(0, img.rows), [&](const cv::Range& range) {
+                    for (int y = range.start; y < range.end; y++)
+                    {
+                        const uchar* luts_top = state.luts.ptr<uchar>(state.y_tiles1[y] * grid_width);
+                        const uchar* luts_bottom = state.luts.ptr<uchar>(state.y_tiles2[y] * grid_width);
+                        const uchar* plane_row = state.plane.ptr<uchar>(y);
+                        const uchar* mask_row = mask.ptr<uchar>(y);
+                        uchar* lab_row = state.lab.ptr<uchar>(y);
+                        for (int x = 0; x < img.cols; x++)
+                            if (mask_row[x])
+                                lab_row[3 * x] = interpolate_luts(luts_top, luts_bottom,
+                                                                  state.x_offsets1[x], state.x_offsets2[x],
+                                                                  state.x_weights[x], state.y_weights[y], plane_row[x]);
+                    }
+                });
+                cv::cvtColor(state.lab, img, cv::COLOR_Lab2BGR);
+            }
+            else
+            {
+                // BGR -> YCrCb -> BGR with an updated luma adds the same luma offset to every channel
+                cv::cvtColor(img, state.plane, cv::COLOR_BGR2GRAY);
+                this->compute_luts(state, mask);
 
-            // Merge the the color planes back into an Lab image
-            dst.copyTo(lab_planes[0]);
-            cv::merge(lab_planes, lab_image);
-            cv::cvtColor(lab_image, img, cv::COLOR_Lab2BGR);
+                parallel_for_ref(cv::Range(0, img.rows), [&](const cv::Range& range) {
+                    for (int y = range.start; y < range.end; y++)
+                    {
+                        const uchar* luts_top = state.luts.ptr<uchar>(state.y_tiles1[y] * grid_width);
+                        const uchar* luts_bottom = state.luts.ptr<uchar>(state.y_tiles2[y] * grid_width);
+                        const uchar* plane_row = state.plane.ptr<uchar>(y);
+                        const uchar* mask_row = mask.ptr<uchar>(y);
+                        uchar* pixel = img.ptr<uchar>(y);
+                        for (int x = 0; x < img.cols; x++, pixel += 3)
+                        {
+                            if (!mask_row[x])
+                                continue;
+                            const int luma = plane_row[x];
+                            const int offset = interpolate_luts(luts_top, luts_bottom,
+                                                                state.x_offsets1[x], state.x_offsets2[x],
+                                                                state.x_weights[x], state.y_weights[y], luma) - luma;
+                            pixel[0] = cv::saturate_cast<uchar>(pixel[0] + offset);
+                            pixel[1] = cv::saturate_cast<uchar>(pixel[1] + offset);
+                            pixel[2] = cv::saturate_cast<uchar>(pixel[2] + offset);
+                        }
+                    }
+                });
+            }
         }
     }
-} //namespace laz
\ No newline at end of file
+} //namespace laz
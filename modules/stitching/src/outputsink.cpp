@@ -0,0 +1,141 @@
+#include "stitching/outputsink.h"
+#include "assert.h"
+
+namespace laz {
+
+    ImageSink::ImageSink(const std::string& _prefix, const std::string& _extension, const std::vector<int>& _params) :
+            m_prefix(_prefix),
+            m_extension(_extension),
+            m_params(_params),
+            m_frame_idx(0)
+    {}
+
+    void ImageSink::write(const cv::Mat& _mosaic)
+    {
+        m_frame_idx++;
+        const std::string path = m_prefix + "_" + std::to_string(m_frame_idx) + "." + m_extension;
+        if (!cv::imwrite(path, _mosaic, m_params))
+            PLOGE << "Could not write mosaic '" << path << "'.";
+    }
+
+    PngSink::PngSink(const std::string& _prefix) : ImageSink(_prefix, "png") {}
+
+    JpegSink::JpegSink(const std::string& _prefix, const int& _quality) :
+            ImageSink(_prefix, "jpg", {cv::IMWRITE_JPEG_QUALITY, _quality})
+    {
+        assert(_quality >= 0 and _quality <= 100);
+    }
+
+    VideoSink::VideoSink(const std::string& _path, const std::string& _codec, const double& _fps) :
+            m_path(_path),
+            m_fps(_fps)
+    {
+        if (_codec.size() != 4){
+            std::string msg = "Error: video codec must be a FourCC code: '" + _codec + "'\n";
+            PLOGE << msg;
+            throw std::runtime_error(msg);
+        }
+        m_fourcc = cv::VideoWriter::fourcc(_codec[0], _codec[1], _codec[2], _codec[3]);
+    }
+
+    VideoSink::~VideoSink()
+    {
+        this->close();
+    }
+
+    void VideoSink::write(const cv::Mat& _mosaic)
+    {
+        // Blenders may output 16-bit mosaics: video codecs take 8-bit frames
+        cv::Mat frame = _mosaic;
+        if (frame.depth() != CV_8U)
+            _mosaic.convertTo(frame, CV_8U);
+
+        if (!m_writer.isOpened())
+        {
+            if (!m_writer.open(m_path, m_fourcc, m_fps, frame.size(), frame.channels() > 1)){
+                std::string msg = "Error: could not open video '" + m_path + "'\n";
+                PLOGE << msg;
+                throw std::runtime_error(msg);
+            }
+            PLOGI << "Writing mosaics to video '" << m_path << "'.";
+        }
+        m_writer.write(frame);
+    }
+
+    void VideoSink::close()
+    {
+        if (m_writer.isOpened())
+            m_writer.release();
+    }
+
+    RawSink::RawSink(const std::string& _path) : m_file(_path, std::ios::binary | std::ios::trunc)
+    {
+        if (!m_file.is_open()){
+            std::string msg = "Error: could not open raw file '" + _path + "'\n";
+            PLOGE << msg;
+            throw std::runtime_error(msg);
+        }
+    }
+
+    RawSink::~RawSink()
+    {
+        this->close();
+    }
+
+    void RawSink::write(const cv::Mat& _mosaic)
+    {
+        const int32_t header[3] = {_mosaic.rows, _mosaic.cols, _mosaic.type()};
+        m_file.write(reinterpret_cast<const char*>(header), sizeof(header));
+        const size_t row_size = _mosaic.cols * _mosaic.elemSize();
+        for (int y = 0; y < _mosaic.rows; y++)
+            m_file.write(reinterpret_cast<const char*>(_mosaic.ptr(y)), row_size);
+    }
+
+    void RawSink::close()
+    {
+        if (m_file.is_open())
+            m_file.close();
+    }
+
+    AsyncSink::AsyncSink(std::unique_ptr<OutputSink> _sink, const int& _queue_capacity) :
+            m_sink(std::move(_sink)),
+            m_queue(_queue_capacity)
+    {
+        assert(m_sink);
+        m_writer = std::thread(&AsyncSink::writer_loop, this);
+    }
+
+    AsyncSink::~AsyncSink()
+    {
+        this->close();
+    }
+
+    void AsyncSink::write(const cv::Mat& _mosaic)
+    {
+        // The caller may reuse its mosaic buffer for the next frame
+        if (!m_queue.push(_mosaic.clone()))
+            PLOGE << "Mosaic dropped: the output sink is closed.";
+    }
+
+    void AsyncSink::close()
+    {
+        m_queue.close();
+        if (m_writer.joinable())
+            m_writer.join();
+        m_sink->close();
+    }
+
+    void AsyncSink::writer_loop()
+    {
+        cv::Mat mosaic;
+        while (m_queue.pop(mosaic))
+        {
+            try {
+                m_sink->write(mosaic);
+            }
+            catch (const std::exception& e) {
+                PLOGE << "Output sink failed: " << e.what();
+            }
+        }
+    }
+} //namespace laz
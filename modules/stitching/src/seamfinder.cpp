@@ -1,12 +1,12 @@
 #include "stitching/seamfinder.h"
 
 namespace laz {
-    void CvSeamFinder::init(const std::vector <cv::Mat>& img_bundle,
-                            const std::vector <cv::Mat>& mask_bundle,
-                            const std::vector <cv::Rect>& corners_bundle) {
+    void CvSeamFinder::init(const std::vector <cv::Mat>& img_bundle, const BundleGeometryPtr& geometry) {
 
-        assert(img_bundle.size() == corners_bundle.size());
-        assert(img_bundle.size() == mask_bundle.size());
+        assert(geometry);
+        assert(img_bundle.size() == geometry->size());
+        const std::vector<cv::Mat>& mask_bundle = geometry->get_mask_bundle();
+        const std::vector<cv::Point>& geometry_tl_points = geometry->get_tl_point_bundle();
 
         std::vector<cv::UMat> img_Ubundle(mask_bundle.size());
         for (int i = 0; i < img_Ubundle.size(); i++)
@@ -25,9 +25,9 @@ namespace laz {
             cv::resize(mask_Ubundle[i], mask_Ubundle[i], cv::Size(), m_seam_downscale, m_seam_downscale, cv::INTER_NEAREST);
         }
 
-        std::vector<cv::Point> tl_point_bundle(corners_bundle.size());
+        std::vector<cv::Point> tl_point_bundle(geometry_tl_points.size());
         for (int i = 0; i < tl_point_bundle.size(); i++)
-            tl_point_bundle[i] = corners_bundle.at(i).tl()*m_seam_downscale;
+            tl_point_bundle[i] = geometry_tl_points.at(i)*m_seam_downscale;
 
         PLOGI << "Finding Optimal Seams...";
         m_seam_finder->find(img_Ubundle, tl_point_bundle, mask_Ubundle);
@@ -4,15 +4,44 @@
 
 namespace laz {
 
-    Stitcher::Stitcher(const StitcherComponents& _components) : m_components(_components)
+    static const std::array<const char*, Stitcher::NR_TIMINGS> timing_names = {
+            "read", "gamma", "exposure", "exposure_update", "seam_update", "blend", "output"};
+
+    Stitcher::Stitcher(const StitcherComponents& _components, const StitcherOptions& _options) :
+            m_components(_components),
+            m_options(_options),
+            m_geometry(_components.streamer->get_geometry()),
+            m_seam_masks(m_geometry->get_mask_bundle()),
+            m_seam_worker(nullptr),
+            m_frame_idx(0),
+            m_exposure_worker(nullptr),
+            m_do_update_exposure(false),
+            m_do_update_seams(false)
     {
+        if (m_options.async_seam_update && m_components.seam_finder)
+            m_seam_worker = std::make_unique<ThreadPool>(1);
+        if (m_options.exposure_update_cadence > 0 && m_components.exp_compensator)
+            m_exposure_worker = std::make_unique<ThreadPool>(1);
+        for (auto& latency : m_stage_latencies)
+            latency = 0.;
         this->init_blender();
     }
 
+    Stitcher::~Stitcher()
+    {
+        this->stop_pipeline();
+
+        // Background tasks use the components: let them finish before the components can be released
+        if (m_pending_seams.valid())
+            m_pending_seams.wait();
+        if (m_pending_exposure.valid())
+            m_pending_exposure.wait();
+    }
+
     void Stitcher::init(const std::vector<cv::Mat>& _src)
     {
         std::vector<cv::Mat> image_bundle = _src;
-        const std::vector<cv::Mat>& mask_bundle = m_components.streamer->get_mask_bundle();
+        const std::vector<cv::Mat>& mask_bundle = m_geometry->get_mask_bundle();
 
         // Gamma Corrector
         if (m_components.gamma_corrector)
@@ -33,24 +62,107 @@ namespace laz {
 
     void Stitcher::init_exp_compensator(const std::vector<cv::Mat>& _src)
     {
-        const std::vector<cv::Mat>& mask_bundle = m_components.streamer->get_mask_bundle();
-        const std::vector<cv::Rect>& corners_bundle = m_components.streamer->get_corners_bundle();
-        m_components.exp_compensator->init(_src, mask_bundle, corners_bundle);
+        if (m_pending_exposure.valid())
+            m_pending_exposure.wait();
+        m_components.exp_compensator->init(_src, m_geometry);
+    }
+
+    void Stitcher::update_exposure(const std::vector<cv::Mat>& _src)
+    {
+        if (!m_exposure_worker)
+        {
+            const auto start = std::chrono::steady_clock::now();
+            m_components.exp_compensator->update(_src);
+            m_timings[Timing::EXPOSURE_UPDATE].record_since(start);
+            return;
+        }
+
+        if (m_pending_exposure.valid())
+        {
+            if (m_pending_exposure.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+                return;
+            try {
+                m_pending_exposure.get();
+            }
+            catch (const std::exception& e) {
+                PLOGE << "Asynchronous exposure update failed: " << e.what();
+            }
+        }
+        if (m_frame_idx % m_options.exposure_update_cadence != 0)
+            return;
+
+        // The compensator publishes the new gains itself: apply() keeps using the current ones meanwhile
+        std::vector<cv::Mat> snapshot(_src.size());
+        for (int i = 0; i < _src.size(); i++)
+            snapshot[i] = _src[i].clone();
+
+        ExposureCompensator* exp_compensator = m_components.exp_compensator;
+        LatencyHistogram* histogram = &m_timings[Timing::EXPOSURE_UPDATE];
+        m_pending_exposure = m_exposure_worker->submit([exp_compensator, histogram, snapshot]() {
+            const auto start = std::chrono::steady_clock::now();
+            exp_compensator->update(snapshot);
+            histogram->record_since(start);
+        });
     }
 
     void Stitcher::init_seam_finder(const std::vector<cv::Mat>& _src)
     {
-        const std::vector<cv::Mat>& mask_bundle = m_components.streamer->get_mask_bundle();
-        const std::vector<cv::Rect>& corners_bundle = m_components.streamer->get_corners_bundle();
-        m_components.seam_finder->init(_src, mask_bundle, corners_bundle);
+        // A pending background update would race with this one on the seam finder: its result is dropped
+        if (m_pending_seams.valid())
+        {
+            m_pending_seams.wait();
+            m_pending_seams = std::future<std::vector<cv::Mat>>();
+        }
+
+        m_components.seam_finder->init(_src, m_geometry);
+        // Seam masks only change here: push them to the blender once instead of on every frame
+        m_seam_masks = m_components.seam_finder->get_seam_masks();
+        m_components.blender->update_masks(m_seam_masks);
+    }
+
+    void Stitcher::launch_seam_update(const std::vector<cv::Mat>& _src)
+    {
+        assert(m_seam_worker);
+        if (m_pending_seams.valid())
+            return;
+
+        // The worker owns a snapshot of the frame; the seam finder is only touched by the worker until the
+        // result is collected by swap_ready_seams()
+        std::vector<cv::Mat> snapshot(_src.size());
+        for (int i = 0; i < _src.size(); i++)
+            snapshot[i] = _src[i].clone();
+
+        SeamFinder* seam_finder = m_components.seam_finder;
+        BundleGeometryPtr geometry = m_geometry;
+        LatencyHistogram* histogram = &m_timings[Timing::SEAM_UPDATE];
+        m_pending_seams = m_seam_worker->submit([seam_finder, geometry, histogram, snapshot]() {
+            const auto start = std::chrono::steady_clock::now();
+            seam_finder->init(snapshot, geometry);
+            histogram->record_since(start);
+            return seam_finder->get_seam_masks();
+        });
+    }
+
+    bool Stitcher::swap_ready_seams()
+    {
+        if (!m_pending_seams.valid() ||
+            m_pending_seams.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+            return false;
+
+        try {
+            m_seam_masks = m_pending_seams.get();
+            PLOGD << "Swapped in asynchronously updated seams.";
+            return true;
+        }
+        catch (const std::exception& e) {
+            PLOGE << "Asynchronous seam update failed, keeping the previous seams: " << e.what();
+            return false;
+        }
     }
 
     void Stitcher::init_blender()
     {
-        const std::vector<cv::Mat>& mask_bundle = m_components.streamer->get_mask_bundle();
-        const std::vector<cv::Rect>& corners_bundle = m_components.streamer->get_corners_bundle();
-        const std::vector<cv::Size>& size_bundle = m_components.streamer->get_size_bundle();
-        m_components.blender->init(mask_bundle, corners_bundle, size_bundle);
+        m_components.blender->init(m_geometry);
     }
 
     void Stitcher::init_from_current_stream()
@@ -62,40 +174,297 @@ namespace laz {
         this->init(initializer_bundle);
     }
 
-    bool Stitcher::read(cv::OutputArray _dst,
-                        const bool& _do_update_exposure,
-                        const bool& _do_update_seams)
+    bool Stitcher::capture(Frame& _frame)
     {
+        const auto start = std::chrono::steady_clock::now();
+        m_components.streamer->read(_frame.img_bundle);
+        m_stage_latencies[Stage::CAPTURE] = m_timings[Timing::READ].record_since(start);
 
-        std::vector<cv::Mat> img_bundle = m_components.streamer->read();
-        for(auto& mat : img_bundle)
+        for(auto& mat : _frame.img_bundle)
             if (mat.empty())
                 return false;
+        return true;
+    }
+
+    void Stitcher::correct(Frame& _frame, const bool& _do_update_exposure, const bool& _do_update_seams)
+    {
+        const auto start = std::chrono::steady_clock::now();
+        std::vector<cv::Mat>& img_bundle = _frame.img_bundle;
+
+        // Frame boundary: seams estimated in the background are swapped in before this frame is processed
+        bool seams_changed = m_seam_worker && this->swap_ready_seams();
 
-        const std::vector <cv::Mat>& mask_bundle = m_components.seam_finder->get_seam_masks();
+        const std::vector <cv::Mat>& mask_bundle = m_seam_masks;
 
         // Gamma Corrector
         if (m_components.gamma_corrector)
+        {
+            const auto gamma_start = std::chrono::steady_clock::now();
             m_components.gamma_corrector->apply(img_bundle, mask_bundle);
+            m_timings[Timing::GAMMA].record_since(gamma_start);
+        }
 
         // Compensator
         if (m_components.exp_compensator){
             if (_do_update_exposure)
-                this->init_exp_compensator(img_bundle);
+                this->update_exposure(img_bundle);
+            const auto exposure_start = std::chrono::steady_clock::now();
             m_components.exp_compensator->apply(img_bundle);
+            m_timings[Timing::EXPOSURE].record_since(exposure_start);
         }
 
         // Seam Finder
-        if (m_components.seam_finder){
-            if (_do_update_seams)
-                this->init_seam_finder(img_bundle);
-            const std::vector <cv::Mat>& updated_seam_masks = m_components.seam_finder->get_seam_masks();
-            m_components.blender->update_masks(updated_seam_masks);
+        if (m_components.seam_finder && _do_update_seams)
+        {
+            if (m_seam_worker)
+                this->launch_seam_update(img_bundle);
+            else
+            {
+                const auto seam_start = std::chrono::steady_clock::now();
+                m_components.seam_finder->init(img_bundle, m_geometry);
+                m_seam_masks = m_components.seam_finder->get_seam_masks();
+                m_timings[Timing::SEAM_UPDATE].record_since(seam_start);
+                seams_changed = true;
+            }
+        }
+
+        // The blender may run on another thread: new seams travel with the frame
+        if (seams_changed)
+            _frame.seam_masks = std::make_shared<const std::vector<cv::Mat>>(m_seam_masks);
+
+        m_frame_idx++;
+        const std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+        m_stage_latencies[Stage::CORRECT] = elapsed.count();
+    }
+
+    void Stitcher::blend(Frame& _frame, cv::OutputArray _dst)
+    {
+        const auto start = std::chrono::steady_clock::now();
+        if (_frame.seam_masks)
+        {
+            m_components.blender->update_masks(*_frame.seam_masks);
+            _frame.seam_masks.reset();
+        }
+        m_components.blender->blend(_frame.img_bundle, _dst);
+        _frame.img_bundle.clear();
+        m_stage_latencies[Stage::BLEND] = m_timings[Timing::BLEND].record_since(start);
+    }
+
+    bool Stitcher::read(cv::OutputArray _dst,
+                        const bool& _do_update_exposure,
+                        const bool& _do_update_seams)
+    {
+        Frame frame;
+        if (m_options.pipeline_queue_capacity > 0)
+        {
+            m_do_update_exposure = _do_update_exposure;
+            m_do_update_seams = _do_update_seams;
+            if (m_pipeline_threads.empty())
+                this->start_pipeline();
+
+            if (!m_blended_queue->pop(frame))
+            {
+                std::lock_guard<std::mutex> lock(m_pipeline_error_mutex);
+                if (m_pipeline_error)
+                    std::rethrow_exception(m_pipeline_error);
+                return false;
+            }
+        }
+        else
+        {
+            if (!this->capture(m_frame))
+                return false;
+            this->correct(m_frame, _do_update_exposure, _do_update_seams);
+            // Blended straight into the caller mosaic, reused when it is already allocated
+            this->blend(m_frame, _dst);
+            return !_dst.empty();
         }
 
-        cv::Mat result, result_mask;
-        m_components.blender->blend(img_bundle, _dst);
+        if (_dst.empty())
+            _dst.assign(frame.mosaic);
+        else
+            frame.mosaic.copyTo(_dst);
         return !_dst.empty();
     }
-} //namespace laz
 
+    bool Stitcher::read(ShmRingWriter& _ring,
+                        const bool& _do_update_exposure,
+                        const bool& _do_update_seams)
+    {
+        if (m_options.pipeline_queue_capacity > 0)
+        {
+            // The blending stage runs ahead of the ring: publish a copy of its mosaics
+            cv::Mat mosaic;
+            if (!this->read(mosaic, _do_update_exposure, _do_update_seams))
+                return false;
+            const auto start = std::chrono::steady_clock::now();
+            mosaic.copyTo(_ring.begin_write(mosaic.size(), mosaic.type()));
+            _ring.commit();
+            m_timings[Timing::OUTPUT].record_since(start);
+            return true;
+        }
+
+        if (!this->capture(m_frame))
+            return false;
+        this->correct(m_frame, _do_update_exposure, _do_update_seams);
+
+        cv::Mat slot = _ring.begin_write(this->get_mosaic_size(), m_components.blender->output_type());
+        cv::Mat mosaic = slot;
+        this->blend(m_frame, mosaic);
+        const auto start = std::chrono::steady_clock::now();
+        if (mosaic.data != slot.data)
+            mosaic.copyTo(_ring.begin_write(mosaic.size(), mosaic.type()));
+        _ring.commit();
+        m_timings[Timing::OUTPUT].record_since(start);
+        return true;
+    }
+
+    cv::Size Stitcher::get_mosaic_size() const
+    {
+        return cv::detail::resultRoi(m_geometry->get_tl_point_bundle(), m_geometry->get_size_bundle()).size();
+    }
+
+    std::vector<Stitcher::StageStats> Stitcher::get_stage_stats() const
+    {
+        const bool pipelined = !m_pipeline_threads.empty();
+        std::vector<StageStats> stats(Stage::NR_STAGES);
+        stats[Stage::CAPTURE] = {"capture", 0, m_stage_latencies[Stage::CAPTURE]};
+        stats[Stage::CORRECT] = {"correct", pipelined ? m_captured_queue->size() : 0, m_stage_latencies[Stage::CORRECT]};
+        stats[Stage::BLEND] = {"blend", pipelined ? m_corrected_queue->size() : 0, m_stage_latencies[Stage::BLEND]};
+        return stats;
+    }
+
+    void Stitcher::record_timing(const Timing& _timing, const double& _ms)
+    {
+        m_timings[_timing].record(_ms);
+    }
+
+    Stitcher::TimingStats Stitcher::get_timing_stats() const
+    {
+        TimingStats stats;
+        for (int t = 0; t < Timing::NR_TIMINGS; t++)
+            stats.stages.emplace_back(timing_names[t], m_timings[t].summary());
+
+        const StreamBundler* streamer = m_components.streamer;
+        stats.cameras.resize(streamer->size());
+        for (int i = 0; i < streamer->size(); i++)
+        {
+            const CameraStream& stream = streamer->get_stream(i);
+            stats.cameras[i].name = stream.get_name();
+            stats.cameras[i].read = streamer->get_read_histogram(i).summary();
+            stats.cameras[i].decode = stream.get_decode_latency().summary();
+            stats.cameras[i].remap = stream.get_remap_latency().summary();
+        }
+        return stats;
+    }
+
+    void Stitcher::reset_timing_stats()
+    {
+        for (auto& histogram : m_timings)
+            histogram.reset();
+    }
+
+    nlohmann::json Stitcher::TimingStats::to_json() const
+    {
+        nlohmann::json json_stages, json_cameras;
+        for (const auto& stage : stages)
+            json_stages[stage.first] = stage.second.to_json();
+        for (const auto& camera : cameras)
+            json_cameras[camera.name] = {{"read", camera.read.to_json()},
+                                         {"decode", camera.decode.to_json()},
+                                         {"remap", camera.remap.to_json()}};
+        return {{"stages", json_stages}, {"cameras", json_cameras}};
+    }
+
+    void Stitcher::start_pipeline()
+    {
+        const int capacity = m_options.pipeline_queue_capacity;
+        m_captured_queue = std::make_unique<BoundedQueue<Frame>>(capacity);
+        m_corrected_queue = std::make_unique<BoundedQueue<Frame>>(capacity);
+        m_blended_queue = std::make_unique<BoundedQueue<Frame>>(capacity);
+
+        PLOGI << "Starting stitching pipeline with queues of " << capacity << " frames.";
+        m_pipeline_threads.emplace_back(&Stitcher::run_capture_stage, this);
+        m_pipeline_threads.emplace_back(&Stitcher::run_correct_stage, this);
+        m_pipeline_threads.emplace_back(&Stitcher::run_blend_stage, this);
+    }
+
+    void Stitcher::stop_pipeline()
+    {
+        if (m_pipeline_threads.empty())
+            return;
+
+        m_captured_queue->close();
+        m_corrected_queue->close();
+        m_blended_queue->close();
+        for (auto& thread : m_pipeline_threads)
+            thread.join();
+        m_pipeline_threads.clear();
+    }
+
+    void Stitcher::set_pipeline_error(const std::exception_ptr& _error)
+    {
+        std::lock_guard<std::mutex> lock(m_pipeline_error_mutex);
+        if (!m_pipeline_error)
+            m_pipeline_error = _error;
+    }
+
+    void Stitcher::run_capture_stage()
+    {
+        try {
+            Frame frame;
+            while (this->capture(frame))
+            {
+                if (!m_captured_queue->push(std::move(frame)))
+                    break;
+                frame = Frame();
+            }
+        }
+        catch (...) {
+            PLOGE << "Capture stage failed.";
+            this->set_pipeline_error(std::current_exception());
+        }
+        m_captured_queue->close();
+    }
+
+    void Stitcher::run_correct_stage()
+    {
+        try {
+            Frame frame;
+            while (m_captured_queue->pop(frame))
+            {
+                this->correct(frame, m_do_update_exposure, m_do_update_seams);
+                if (!m_corrected_queue->push(std::move(frame)))
+                    break;
+                frame = Frame();
+            }
+        }
+        catch (...) {
+            PLOGE << "Correction stage failed.";
+            this->set_pipeline_error(std::current_exception());
+        }
+        // Closing the input as well stops the upstream stage on failure
+        m_corrected_queue->close();
+        m_captured_queue->close();
+    }
+
+    void Stitcher::run_blend_stage()
+    {
+        try {
+            Frame frame;
+            while (m_corrected_queue->pop(frame))
+            {
+                this->blend(frame, frame.mosaic);
+                if (!m_blended_queue->push(std::move(frame)))
+                    break;
+                frame = Frame();
+            }
+        }
+        catch (...) {
+            PLOGE << "Blending stage failed.";
+            this->set_pipeline_error(std::current_exception());
+        }
+        m_blended_queue->close();
+        m_corrected_queue->close();
+    }
+} //namespace laz
@@ -0,0 +1,189 @@
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <unistd.h>
+
+#include "gtest/gtest.h"
+#include <opencv2/core.hpp>
+
+#include "core/camera.h"
+#include "core/cvcamera.h"
+#include "core/camerastream.h"
+#include "core/mapcache.h"
+#include "core/math.h"
+
+namespace TestConfig{
+    static const cv::Size dims(640, 480);
+    static const float rot_radius = 700.f;
+    static const float map_tolerance = 1e-3f;
+    static const int max_boundary_pixels = 32;
+}
+
+/**
+ * Reference cylindrical maps, evaluated pixel per pixel as CylindricalCamera used to. raw_mapx and raw_mapy
+ * receive the coordinates before invalid ones are set to -1.
+ */
+void legacy_cylindrical_maps(const cv::Mat& forward, const cv::Mat& backward, const cv::Size& dims,
+                             cv::Mat& mapx, cv::Mat& mapy, cv::Mat& raw_mapx, cv::Mat& raw_mapy)
+{
+    mapx = cv::Mat(dims, CV_32FC1);
+    mapy = cv::Mat(dims, CV_32FC1);
+    raw_mapx = cv::Mat(dims, CV_32FC1);
+    raw_mapy = cv::Mat(dims, CV_32FC1);
+    for(int j=0; j < mapx.cols; j++){
+        for(int i=0; i < mapx.rows; i++){
+            const cv::Vec3f& n_vec = cv::Mat( backward * cv::Mat(cv::Vec3f(i,j,1)) ).at<cv::Vec3f>(0);
+            const cv::Vec3f cyl_vec(std::sin(n_vec[0]), n_vec[1], std::cos(n_vec[0]));
+            const cv::Vec3f& cyl_proj = cv::Mat( forward * cv::Mat(cyl_vec) ).at<cv::Vec3f>(0);
+            cv::Vec2f c_cyl_proj = cv::Vec2f(cyl_proj[0]/cyl_proj[2], cyl_proj[1]/cyl_proj[2]);
+            raw_mapx.at<float>(i,j) = c_cyl_proj[0];
+            raw_mapy.at<float>(i,j) = c_cyl_proj[1];
+
+            if (c_cyl_proj[0] < 0 or c_cyl_proj[0] > dims.width)
+                c_cyl_proj[0] = -1.0;
+            if (c_cyl_proj[1] < 0 or c_cyl_proj[1] > dims.height)
+                c_cyl_proj[1] = -1.0;
+
+            mapx.at<float>(i,j) = c_cyl_proj[0];
+            mapy.at<float>(i,j) = c_cyl_proj[1];
+        }
+    }
+}
+
+/**
+ * Compare two maps. A coordinate may be valid in one map only if its exact legacy value lies within the
+ * tolerance of 0 or of the limit, where rounding decides on which side of the limit it falls.
+ * @param raw_ref_map : Legacy coordinates before invalid ones are set to -1
+ * @param limit : Width for x maps, height for y maps
+ */
+void expect_maps_near(const cv::Mat& map, const cv::Mat& ref_map, const cv::Mat& raw_ref_map, const float& limit,
+                      const float& tolerance)
+{
+    ASSERT_EQ(map.size(), ref_map.size());
+    ASSERT_EQ(map.type(), ref_map.type());
+
+    int nr_valid = 0, nr_boundary_pixels = 0, nr_validity_mismatches = 0, nr_unexpected_mismatches = 0;
+    float max_error = 0.f;
+    for (int i = 0; i < map.rows; i++) {
+        for (int j = 0; j < map.cols; j++) {
+            const float value = map.at<float>(i, j), ref_value = ref_map.at<float>(i, j);
+            const float raw_ref_value = raw_ref_map.at<float>(i, j);
+            const bool is_boundary = std::abs(raw_ref_value) <= tolerance || std::abs(raw_ref_value - limit) <= tolerance;
+            nr_boundary_pixels += is_boundary;
+            if ((value == -1.f) != (ref_value == -1.f)) {
+                nr_validity_mismatches++;
+                nr_unexpected_mismatches += !is_boundary;
+            }
+            else {
+                nr_valid += (ref_value != -1.f);
+                max_error = std::max(max_error, std::abs(value - ref_value));
+            }
+        }
+    }
+    // The comparison is meaningless if the projection leaves no valid coordinate
+    EXPECT_GT(nr_valid, static_cast<int>(map.total()) / 2);
+    EXPECT_EQ(nr_unexpected_mismatches, 0);
+    EXPECT_LE(nr_validity_mismatches, nr_boundary_pixels);
+    EXPECT_LE(nr_boundary_pixels, TestConfig::max_boundary_pixels);
+    EXPECT_LE(max_error, tolerance);
+}
+
+TEST(CameraTests, CylindricalMapsMatchLegacyImplementation){
+    // Unit cylinder around the extrinsic camera: most of the image stays within the maps
+    cv::Mat extrinsic = (cv::Mat_<float>(3, 3) << 760.f, 0.f, 325.f,
+                                                  0.f, 755.f, 236.f,
+                                                  0.f, 0.f, 1.f);
+    cv::Mat forward_mat = extrinsic, backward_mat = extrinsic.inv();
+
+    cv::Mat ref_mapx, ref_mapy, raw_ref_mapx, raw_ref_mapy;
+    legacy_cylindrical_maps(forward_mat, backward_mat, TestConfig::dims, ref_mapx, ref_mapy, raw_ref_mapx, raw_ref_mapy);
+
+    cv::Mat mapx, mapy;
+    math::build_cylindrical_maps(cv::Matx33f(forward_mat), cv::Matx33f(backward_mat), TestConfig::dims, mapx, mapy);
+
+    expect_maps_near(mapx, ref_mapx, raw_ref_mapx, TestConfig::dims.width, TestConfig::map_tolerance);
+    expect_maps_near(mapy, ref_mapy, raw_ref_mapy, TestConfig::dims.height, TestConfig::map_tolerance);
+}
+
+TEST(CameraTests, MapsAreBuiltOnceOnFirstUse){
+    laz::CameraParameters parameters;
+    parameters.name = "cam";
+    parameters.dims = TestConfig::dims;
+    parameters.intrinsic = (cv::Mat_<float>(3, 3) << 760.f, 0.f, 325.f,
+                                                     0.f, 755.f, 236.f,
+                                                     0.f, 0.f, 1.f);
+    parameters.dist_coeffs = (cv::Mat_<float>(1, 5) << -0.09f, 0.07f, 0.f, 0.f, 0.f);
+    parameters.extrinsic = parameters.intrinsic.clone();
+    parameters.rotation = cv::Mat::eye(3, 3, CV_32FC1);
+    parameters.radius = TestConfig::rot_radius;
+
+    const long nr_builds = laz::Camera::get_nr_map_builds();
+    cv::Mat img(TestConfig::dims, CV_8UC3, cv::Scalar::all(128)), remapped;
+
+    // Images of the same camera share one map set
+    const laz::IntrinsicCamera intrinsic_cam(parameters);
+    std::vector<laz::CameraCalibration> calib_cams(3, laz::CameraCalibration(intrinsic_cam, "unused.png"));
+    EXPECT_EQ(laz::Camera::get_nr_map_builds(), nr_builds);
+    for (const auto& calib_cam : calib_cams)
+        calib_cam.remap(img, remapped);
+    intrinsic_cam.remap(img, remapped);
+    EXPECT_EQ(laz::Camera::get_nr_map_builds(), nr_builds + 1);
+
+    // The projected camera builds its own maps once, without the intermediate undistortion maps
+    const laz::CvCylindricalCamera cyl_cam{laz::RotationCamera(parameters)};
+    EXPECT_FALSE(cyl_cam.get_corners().empty());
+    EXPECT_EQ(cyl_cam.size(), cyl_cam.get_corners().size());
+    EXPECT_EQ(laz::Camera::get_nr_map_builds(), nr_builds + 1);
+    cyl_cam.remap(img, remapped);
+    EXPECT_EQ(cyl_cam.get_mask().size(), cyl_cam.size());
+    EXPECT_EQ(cyl_cam.get_mask().data, cyl_cam.get_mask().data);
+    const laz::CvCylindricalCamera cyl_cam_copy = cyl_cam;
+    cyl_cam_copy.remap(img, remapped);
+    EXPECT_EQ(laz::Camera::get_nr_map_builds(), nr_builds + 2);
+}
+
+TEST(CameraTests, MapCacheRoundTrip){
+    cv::Mat intrinsic = (cv::Mat_<float>(3, 3) << 760.f, 0.f, 325.f,
+                                                  0.f, 755.f, 236.f,
+                                                  0.f, 0.f, 1.f);
+    cv::Mat dist_coeffs = (cv::Mat_<float>(1, 5) << -0.09f, 0.07f, 0.f, 0.f, 0.f);
+    cv::Mat rotation = (cv::Mat_<float>(3, 3) << 0.96f, 0.f, 0.28f,
+                                                 0.f, 1.f, 0.f,
+                                                 -0.28f, 0.f, 0.96f);
+    const laz::IntrinsicCamera intrinsic_cam(laz::Camera("cam", TestConfig::dims), intrinsic, dist_coeffs);
+    const laz::RotationCamera rot_cam(laz::ExtrinsicCamera(intrinsic_cam, intrinsic), rotation, TestConfig::rot_radius);
+    const laz::CvCylindricalCamera cam(rot_cam);
+
+    char cache_dir[] = "/tmp/laz_map_cache_XXXXXX";
+    ASSERT_NE(mkdtemp(cache_dir), nullptr);
+    const laz::MapCache map_cache(cache_dir);
+    const std::string key = laz::MapCache::make_key("calibration", "cylindrical");
+    EXPECT_NE(key, laz::MapCache::make_key("calibration", "spherical"));
+
+    laz::CameraMaps maps;
+    EXPECT_FALSE(map_cache.load(key, maps));
+    map_cache.store(key, cam.get_maps());
+    ASSERT_TRUE(map_cache.load(key, maps));
+
+    // The mapping outlives its file
+    std::remove(map_cache.get_path(key).c_str());
+    rmdir(cache_dir);
+
+    const laz::CvCylindricalCamera cached_cam(rot_cam, maps);
+    EXPECT_EQ(cached_cam.get_corners(), cam.get_corners());
+    EXPECT_EQ(cv::norm(cached_cam.get_mask(), cam.get_mask(), cv::NORM_INF), 0.);
+
+    cv::Mat img(TestConfig::dims, CV_8UC3), remapped, cached_remapped;
+    cv::randu(img, cv::Scalar::all(0), cv::Scalar::all(255));
+    cam.remap(img, remapped);
+    cached_cam.remap(img, cached_remapped);
+    EXPECT_EQ(cv::norm(cached_remapped, remapped, cv::NORM_INF), 0.);
+}
+
+//-------------------------------------------------------------------------------
+// Unit Tests
+//-------------------------------------------------------------------------------
+int main(int argc, char **argv) {
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
@@ -0,0 +1,227 @@
+#include <atomic>
+#include <cstdlib>
+#include <new>
+#include <thread>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include <opencv2/core.hpp>
+#include <opencv2/core/ocl.hpp>
+#include <opencv2/imgproc.hpp>
+
+#include "core/framepool.h"
+#include "stitching/gammacorrector.h"
+#include "stitching/exposurecompensator.h"
+#include "stitching/seamfinder.h"
+#include "stitching/blender.h"
+#include "stitching/stitcher.h"
+#include "bundlefixture.h"
+#include "syntheticrig.h"
+
+namespace TestConfig{
+    static const int nr_warmup_frames = 3;
+    static const int nr_frames = 10;
+    static const int nr_threads = 4;
+    static const float rig_overlap = 0.3f;
+    static const size_t frame_bytes = dims.area() * 3;    // CV_8UC3
+}
+
+// Every operator new of the executable, from any thread
+static std::atomic<long> nr_heap_allocations(0);
+
+void* operator new(std::size_t _size)
+{
+    nr_heap_allocations.fetch_add(1, std::memory_order_relaxed);
+    if (void* ptr = std::malloc(_size ? _size : 1))
+        return ptr;
+    throw std::bad_alloc();
+}
+
+void* operator new[](std::size_t _size)
+{
+    return ::operator new(_size);
+}
+
+void operator delete(void* _ptr) noexcept { std::free(_ptr); }
+void operator delete[](void* _ptr) noexcept { std::free(_ptr); }
+void operator delete(void* _ptr, std::size_t) noexcept { std::free(_ptr); }
+void operator delete[](void* _ptr, std::size_t) noexcept { std::free(_ptr); }
+
+/**
+ * Installs an allocator as the default one for the lifetime of the scope. Declare it after the allocator and before
+ * the Mats: these are released before the default allocator is restored, and the allocator outlives them.
+ */
+class ScopedDefaultAllocator {
+public:
+    explicit ScopedDefaultAllocator(cv::MatAllocator* _allocator) :
+            m_previous_allocator(cv::Mat::getDefaultAllocator()),
+            m_use_opencl(cv::ocl::useOpenCL()),
+            m_nr_threads(cv::getNumThreads())
+    {
+        cv::Mat::setDefaultAllocator(_allocator);
+        // UMats are allocated by the default allocator only without OpenCL. A single OpenCV worker makes the number
+        // of temporary buffers alive at once deterministic, and keeps cv::parallel_for_ from allocating a job per
+        // call: see FramePoolAllocator for the allocations left with several workers
+        cv::ocl::setUseOpenCL(false);
+        cv::setNumThreads(1);
+    }
+
+    ~ScopedDefaultAllocator()
+    {
+        cv::setNumThreads(m_nr_threads);
+        cv::ocl::setUseOpenCL(m_use_opencl);
+        cv::Mat::setDefaultAllocator(m_previous_allocator);
+    }
+
+private:
+    cv::MatAllocator* m_previous_allocator;
+    const bool m_use_opencl;
+    const int m_nr_threads;
+};
+
+/**
+ * Pool and heap allocations of Stitcher::read() over a synthetic rig, whose cameras are read by parallel workers
+ * as in the stitching app, once the first frames have warmed the pool up.
+ */
+template<typename BlenderType>
+void count_stitching_allocations(long& _nr_pool_allocations, long& _nr_heap_allocations)
+{
+    laz::FramePoolAllocator pool;
+    ScopedDefaultAllocator scoped_allocator(&pool);
+
+    SyntheticRig rig(TestConfig::nr_cams, TestConfig::dims, TestConfig::rig_overlap, TestConfig::nr_cams);
+    laz::GammaCorrector gamma_corrector(1.2f, 10);
+    laz::CvExposureCompensatorGainBlocks exposure_compensator;
+    BlenderType blender;
+    laz::Stitcher stitcher = laz::Stitcher::StitcherBuilder(rig.get_bundler(), &blender)
+            .attach_gamma_corrector(&gamma_corrector)
+            .attach_exp_compensator(&exposure_compensator)
+            .build();
+    stitcher.init_from_current_stream();
+
+    cv::Mat mosaic;
+    for (int f = 0; f < TestConfig::nr_warmup_frames; f++)
+        ASSERT_TRUE(stitcher.read(mosaic));
+
+    // Nothing but the stitcher in the measured loop: a failed expectation would allocate its message
+    const long nr_pool_allocations = pool.get_nr_allocations();
+    const long nr_pool_reuses = pool.get_nr_reuses();
+    const long nr_allocations = nr_heap_allocations.load();
+    bool all_read = true;
+    for (int f = 0; f < TestConfig::nr_frames; f++)
+        all_read &= stitcher.read(mosaic);
+    _nr_heap_allocations = nr_heap_allocations.load() - nr_allocations;
+    _nr_pool_allocations = pool.get_nr_allocations() - nr_pool_allocations;
+
+    EXPECT_TRUE(all_read);
+    EXPECT_GE(pool.get_nr_reuses() - nr_pool_reuses, TestConfig::nr_frames * (TestConfig::nr_cams + 1));
+}
+
+TEST(FramePoolTests, StitchingLoopDoesNotAllocateOnceWarm){
+    long pool_allocations = -1, heap_allocations = -1;
+    count_stitching_allocations<laz::BlenderStaticFeather>(pool_allocations, heap_allocations);
+    EXPECT_EQ(pool_allocations, 0);
+    EXPECT_EQ(heap_allocations, 0);
+}
+
+TEST(FramePoolTests, CvBlenderLoopDoesNotAllocateMatsOnceWarm){
+    // cv::detail blenders allocate their own bookkeeping: only their Mat buffers are covered by the pool
+    long pool_allocations = -1, heap_allocations = -1;
+    count_stitching_allocations<laz::CvBlenderFeather>(pool_allocations, heap_allocations);
+    EXPECT_EQ(pool_allocations, 0);
+}
+
+TEST(FramePoolTests, UMatWrappersAreRecycled){
+    laz::FramePoolAllocator pool;
+    ScopedDefaultAllocator scoped_allocator(&pool);
+
+    const std::vector<cv::Mat> img_bundle = make_images();
+    const long nr_allocations = pool.get_nr_allocations();
+    const size_t pooled_bytes = pool.get_pooled_bytes();
+
+    // Mat::getUMat() wraps the Mat data in a USER_ALLOCATED UMatData from the Mat allocator
+    for (int f = 0; f < TestConfig::nr_frames; f++)
+    {
+        cv::UMat img_u = img_bundle.front().getUMat(cv::ACCESS_READ);
+        EXPECT_EQ(img_bundle.front().u->refcount, 2);
+    }
+
+    EXPECT_EQ(pool.get_nr_allocations(), nr_allocations + 1);
+    EXPECT_EQ(pool.get_pooled_bytes(), pooled_bytes);    // The Mat data is left to its owner
+    EXPECT_EQ(img_bundle.front().u->refcount, 1);        // And released by every wrapper
+}
+
+TEST(FramePoolTests, SeamFinderDoesNotAllocateOnceWarm){
+    laz::FramePoolAllocator pool;
+    ScopedDefaultAllocator scoped_allocator(&pool);
+
+    const laz::BundleGeometryPtr geometry = make_geometry();
+    const std::vector<cv::Mat> img_bundle = make_images();
+    laz::CvSeamFinderVoronoi seam_finder;
+
+    for (int f = 0; f < TestConfig::nr_warmup_frames; f++)
+        seam_finder.init(img_bundle, geometry);
+    const long nr_allocations = pool.get_nr_allocations();
+
+    for (int f = 0; f < TestConfig::nr_frames; f++)
+        seam_finder.init(img_bundle, geometry);
+
+    EXPECT_EQ(pool.get_nr_allocations(), nr_allocations);
+    for (const auto& img : img_bundle)
+        EXPECT_EQ(img.u->refcount, 1);
+}
+
+TEST(FramePoolTests, PooledBytesAreCapped){
+    laz::FramePoolAllocator pool(TestConfig::frame_bytes);
+    ScopedDefaultAllocator scoped_allocator(&pool);
+
+    {
+        cv::Mat frame_a(TestConfig::dims, CV_8UC3), frame_b(TestConfig::dims, CV_8UC3);
+    }
+    EXPECT_EQ(pool.get_nr_allocations(), 2);
+    EXPECT_EQ(pool.get_pooled_bytes(), TestConfig::frame_bytes);
+
+    {
+        cv::Mat frame_a(TestConfig::dims, CV_8UC3), frame_b(TestConfig::dims, CV_8UC3);
+        EXPECT_EQ(pool.get_pooled_bytes(), size_t(0));
+    }
+    EXPECT_EQ(pool.get_nr_allocations(), 3);
+    EXPECT_EQ(pool.get_nr_reuses(), 1);
+    EXPECT_EQ(pool.get_pooled_bytes(), TestConfig::frame_bytes);
+
+    pool.clear();
+    EXPECT_EQ(pool.get_pooled_bytes(), size_t(0));
+}
+
+TEST(FramePoolTests, BuffersAreReusedAcrossThreads){
+    laz::FramePoolAllocator pool;
+    ScopedDefaultAllocator scoped_allocator(&pool);
+
+    // Frames allocated by the workers and released by the main thread, as the stream bundler does
+    std::vector<cv::Mat> frames(TestConfig::nr_threads);
+    std::vector<std::thread> workers;
+    for (int t = 0; t < TestConfig::nr_threads; t++)
+        workers.emplace_back([&frames, t]() { frames[t].create(TestConfig::dims, CV_8UC3); });
+    for (auto& worker : workers)
+        worker.join();
+    frames.clear();
+    EXPECT_EQ(pool.get_nr_allocations(), TestConfig::nr_threads);
+    EXPECT_EQ(pool.get_pooled_bytes(), TestConfig::nr_threads * TestConfig::frame_bytes);
+
+    // At most one frame alive per worker: all served from the buffers released by the other thread
+    workers.clear();
+    for (int t = 0; t < TestConfig::nr_threads; t++)
+        workers.emplace_back([t]() {
+            for (int f = 0; f < TestConfig::nr_frames; f++)
+            {
+                cv::Mat frame(TestConfig::dims, CV_8UC3);
+                frame.setTo(cv::Scalar::all(t));
+            }
+        });
+    for (auto& worker : workers)
+        worker.join();
+
+    EXPECT_EQ(pool.get_nr_allocations(), TestConfig::nr_threads);
+    EXPECT_EQ(pool.get_nr_reuses(), TestConfig::nr_threads * TestConfig::nr_frames);
+    EXPECT_EQ(pool.get_pooled_bytes(), TestConfig::nr_threads * TestConfig::frame_bytes);
+}
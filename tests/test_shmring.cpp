@@ -0,0 +1,112 @@
+#include <string>
+#include <unistd.h>
+#include <sys/wait.h>
+
+#include "gtest/gtest.h"
+#include <opencv2/core.hpp>
+
+#include "core/shmring.h"
+
+namespace TestConfig{
+    static const std::string ring_name = "/laz_test_shmring";
+    static const cv::Size dims(320, 120);
+    static const int nr_slots = 4;
+    static const int nr_frames = 100;
+}
+
+/**
+ * Frame content identifying its sequence number.
+ */
+static cv::Scalar frame_value(const uint64_t& seq)
+{
+    return cv::Scalar(seq % 256, (seq * 7) % 256, (seq * 13) % 256);
+}
+
+TEST(ShmRingTests, ConsumerProcessReadsPublishedFrames){
+    laz::ShmRingWriter writer(TestConfig::ring_name, TestConfig::nr_slots,
+                              TestConfig::dims.area() * CV_ELEM_SIZE(CV_8UC3));
+    laz::ShmRingReader reader(TestConfig::ring_name);
+
+    const pid_t producer = fork();
+    ASSERT_GE(producer, 0);
+    if (producer == 0)
+    {
+        // Paced below the consumer speed: no frame should be dropped
+        for (uint64_t seq = 1; seq <= TestConfig::nr_frames; seq++)
+        {
+            writer.begin_write(TestConfig::dims, CV_8UC3).setTo(frame_value(seq));
+            writer.commit();
+            usleep(2000);
+        }
+        _exit(0);
+    }
+
+    laz::ShmFrame frame;
+    uint64_t last_seq = 0;
+    int nr_read = 0, nr_overwritten = 0;
+    while (reader.read(frame, 1000))
+    {
+        ASSERT_EQ(frame.image.size(), TestConfig::dims);
+        ASSERT_EQ(frame.image.type(), CV_8UC3);
+        const cv::Scalar mean_value = cv::mean(frame.image);
+        if (!reader.is_valid(frame))
+        {
+            // The producer wrapped around while the frame was checked, ex. on a loaded machine
+            nr_overwritten++;
+            continue;
+        }
+        EXPECT_GT(frame.seq, last_seq);
+        EXPECT_EQ(mean_value, frame_value(frame.seq));
+        last_seq = frame.seq;
+        nr_read++;
+    }
+
+    int status = 0;
+    waitpid(producer, &status, 0);
+    EXPECT_EQ(WEXITSTATUS(status), 0);
+    EXPECT_EQ(last_seq, TestConfig::nr_frames);
+    EXPECT_EQ(nr_read + nr_overwritten + reader.get_nr_dropped(), TestConfig::nr_frames);
+}
+
+TEST(ShmRingTests, SlowConsumerDetectsOverwrittenFrames){
+    laz::ShmRingWriter writer(TestConfig::ring_name, TestConfig::nr_slots,
+                              TestConfig::dims.area() * CV_ELEM_SIZE(CV_8UC3));
+    laz::ShmRingReader reader(TestConfig::ring_name);
+
+    // The slot is written in place: no copy on either side
+    cv::Mat slot = writer.begin_write(TestConfig::dims, CV_8UC3);
+    slot.setTo(frame_value(1));
+    writer.commit();
+
+    laz::ShmFrame frame;
+    ASSERT_TRUE(reader.read(frame, 0));
+    EXPECT_EQ(frame.seq, 1u);
+    EXPECT_EQ(frame.image.data, slot.data);
+    EXPECT_TRUE(reader.is_valid(frame));
+
+    // Wrap around the ring: the slot of the first frame is rewritten
+    for (uint64_t seq = 2; seq <= 2 * TestConfig::nr_slots; seq++)
+    {
+        writer.begin_write(TestConfig::dims, CV_8UC3).setTo(frame_value(seq));
+        writer.commit();
+    }
+    EXPECT_FALSE(reader.is_valid(frame));
+
+    // The reader jumps over the frames it cannot read anymore
+    ASSERT_TRUE(reader.read(frame, 0));
+    EXPECT_GT(frame.seq, 2u);
+    EXPECT_EQ(reader.get_nr_dropped(), frame.seq - 2);
+    EXPECT_EQ(cv::mean(frame.image), frame_value(frame.seq));
+
+    while (reader.read(frame, 10))
+        EXPECT_TRUE(reader.is_valid(frame));
+    EXPECT_EQ(frame.seq, 2u * TestConfig::nr_slots);
+}
+
+//-------------------------------------------------------------------------------
+// Unit Tests
+//-------------------------------------------------------------------------------
+int main(int argc, char **argv) {
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
@@ -2,3 +2,186 @@
 // Created by jcruel on 2021-03-18.
 //
 
+#include <atomic>
+#include <memory>
+
+#include "gtest/gtest.h"
+#include <opencv2/core.hpp>
+#include <opencv2/imgproc.hpp>
+#include <opencv2/stitching/detail/blenders.hpp>
+
+#include "stitching/blender.h"
+#include "bundlefixture.h"
+
+namespace TestConfig{
+    static const float blend_strength = 5.f;
+    static const int nr_frames = 5;
+    static const int border = 16;    // Margin of the caller buffer around the mosaic ROI
+    static const int nr_stripes = 4;
+    static const double stripes_tolerance = 1.;    // Max absolute difference to a single blender, in CV_16S
+}
+
+/**
+ * Forwards to the standard allocator and counts the allocations.
+ */
+class CountingAllocator : public cv::MatAllocator {
+public:
+    CountingAllocator() : m_allocator(cv::Mat::getStdAllocator()), m_nr_allocations(0) {}
+
+    cv::UMatData* allocate(int dims, const int* sizes, int type, void* data, size_t* step,
+                           cv::AccessFlag flags, cv::UMatUsageFlags usage_flags) const override
+    {
+        m_nr_allocations++;
+        return m_allocator->allocate(dims, sizes, type, data, step, flags, usage_flags);
+    }
+
+    bool allocate(cv::UMatData* data, cv::AccessFlag access_flags, cv::UMatUsageFlags usage_flags) const override
+    {
+        return m_allocator->allocate(data, access_flags, usage_flags);
+    }
+
+    void deallocate(cv::UMatData* data) const override
+    {
+        m_allocator->deallocate(data);
+    }
+
+    int get_nr_allocations() const { return m_nr_allocations; }
+
+private:
+    cv::MatAllocator* m_allocator;
+    mutable std::atomic<int> m_nr_allocations;
+};
+
+/**
+ * Blend frames into an ROI of a larger caller buffer, and count the Mat allocations once warmed up.
+ */
+template <class TBlender>
+void expect_blend_in_place_without_allocation()
+{
+    TBlender blender(TestConfig::blend_strength);
+    const laz::BundleGeometryPtr geometry = make_geometry();
+    blender.init(geometry);
+    const std::vector<cv::Mat> img_bundle = make_images();
+
+    const cv::Size mosaic_size = blender.output_size();
+    const cv::Scalar sentinel = cv::Scalar::all(77);
+    cv::Mat buffer(mosaic_size + cv::Size(2 * TestConfig::border, 2 * TestConfig::border), blender.output_type(), sentinel);
+    cv::Mat mosaic = buffer(cv::Rect(cv::Point(TestConfig::border, TestConfig::border), mosaic_size));
+    const uchar* mosaic_data = mosaic.data;
+
+    // Warm up: lazily allocated buffers, and the new seams of the stitcher
+    blender.blend(img_bundle, mosaic);
+    blender.update_masks(geometry->get_mask_bundle());
+    blender.blend(img_bundle, mosaic);
+
+    CountingAllocator allocator;
+    cv::MatAllocator* default_allocator = cv::Mat::getDefaultAllocator();
+    cv::Mat::setDefaultAllocator(&allocator);
+    for (int f = 0; f < TestConfig::nr_frames; f++)
+        blender.blend(img_bundle, mosaic);
+    cv::Mat::setDefaultAllocator(default_allocator);
+
+    EXPECT_EQ(allocator.get_nr_allocations(), 0);
+    EXPECT_EQ(mosaic.data, mosaic_data);
+
+    // The buffer around the ROI is left untouched
+    cv::Mat outside = buffer.clone();
+    outside(cv::Rect(cv::Point(TestConfig::border, TestConfig::border), mosaic_size)).setTo(sentinel);
+    EXPECT_EQ(cv::norm(outside, cv::Mat(buffer.size(), buffer.type(), sentinel), cv::NORM_INF), 0.);
+}
+
+TEST(BlenderTests, CvFeatherBlendsInPlaceWithoutAllocation){
+    expect_blend_in_place_without_allocation<laz::CvBlenderFeather>();
+}
+
+TEST(BlenderTests, StaticFeatherBlendsInPlaceWithoutAllocation){
+    expect_blend_in_place_without_allocation<laz::BlenderStaticFeather>();
+}
+
+TEST(BlenderTests, StaticMultiBandBlendsInPlaceWithoutAllocation){
+    expect_blend_in_place_without_allocation<laz::BlenderStaticMultiBand>();
+}
+
+TEST(BlenderTests, CvFeatherMatchesOpenCvFeatherBlender){
+    laz::CvBlenderFeather blender(TestConfig::blend_strength);
+    const laz::BundleGeometryPtr geometry = make_geometry();
+    blender.init(geometry);
+    const std::vector<cv::Mat> img_bundle = make_images();
+
+    cv::Mat mosaic;
+    blender.blend(img_bundle, mosaic);
+
+    cv::detail::FeatherBlender ref_blender(blender.get_sharpness());
+    ref_blender.prepare(geometry->get_tl_point_bundle(), geometry->get_size_bundle());
+    for (int i = 0; i < TestConfig::nr_cams; i++)
+    {
+        cv::Mat img_s;
+        img_bundle[i].convertTo(img_s, CV_16S);
+        ref_blender.feed(img_s, geometry->get_mask_bundle()[i], geometry->get_tl_point_bundle()[i]);
+    }
+    cv::Mat ref_mosaic, ref_mosaic_mask;
+    ref_blender.blend(ref_mosaic, ref_mosaic_mask);
+
+    ASSERT_EQ(mosaic.size(), ref_mosaic.size());
+    ASSERT_EQ(mosaic.type(), ref_mosaic.type());
+    EXPECT_EQ(cv::norm(mosaic, ref_mosaic, cv::NORM_INF), 0.);
+}
+
+/**
+ * Blend with a single cv::detail::Blender over the whole mosaic.
+ */
+cv::Mat blend_with_single_blender(cv::detail::Blender& blender, const laz::BundleGeometryPtr& geometry,
+                                  const std::vector<cv::Mat>& img_bundle)
+{
+    blender.prepare(geometry->get_tl_point_bundle(), geometry->get_size_bundle());
+    for (int i = 0; i < geometry->size(); i++)
+    {
+        cv::Mat img_s;
+        img_bundle[i].convertTo(img_s, CV_16S);
+        blender.feed(img_s, geometry->get_mask_bundle()[i], geometry->get_tl_point_bundle()[i]);
+    }
+    cv::Mat mosaic, mosaic_mask;
+    blender.blend(mosaic, mosaic_mask);
+    return mosaic;
+}
+
+void expect_stripes_match_single_blender(const int& blender_type, const int& nr_stripes)
+{
+    laz::CvBlenderStripes blender(blender_type, nr_stripes, TestConfig::blend_strength);
+    const laz::BundleGeometryPtr geometry = make_geometry();
+    blender.init(geometry);
+    const std::vector<cv::Mat> img_bundle = make_images();
+
+    cv::Mat mosaic;
+    blender.blend(img_bundle, mosaic);
+
+    cv::Ptr<cv::detail::Blender> ref_blender = cv::detail::Blender::createDefault(blender_type, false);
+    if (blender_type == cv::detail::Blender::FEATHER)
+        dynamic_cast<cv::detail::FeatherBlender*>(ref_blender.get())->setSharpness(blender.get_sharpness());
+    else
+        dynamic_cast<cv::detail::MultiBandBlender*>(ref_blender.get())->setNumBands(blender.get_num_bands());
+    const cv::Mat ref_mosaic = blend_with_single_blender(*ref_blender, geometry, img_bundle);
+
+    ASSERT_EQ(mosaic.size(), ref_mosaic.size());
+    ASSERT_EQ(mosaic.type(), ref_mosaic.type());
+    EXPECT_LE(cv::norm(mosaic, ref_mosaic, cv::NORM_INF), TestConfig::stripes_tolerance)
+            << nr_stripes << " stripes";
+}
+
+TEST(BlenderTests, FeatherStripesMatchSingleBlender){
+    expect_stripes_match_single_blender(cv::detail::Blender::FEATHER, 1);
+    expect_stripes_match_single_blender(cv::detail::Blender::FEATHER, TestConfig::nr_stripes);
+}
+
+TEST(BlenderTests, MultiBandStripesMatchSingleBlender){
+    expect_stripes_match_single_blender(cv::detail::Blender::MULTI_BAND, 1);
+    expect_stripes_match_single_blender(cv::detail::Blender::MULTI_BAND, TestConfig::nr_stripes);
+}
+
+//-------------------------------------------------------------------------------
+// Unit Tests
+//-------------------------------------------------------------------------------
+int main(int argc, char **argv) {
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
@@ -0,0 +1,49 @@
+#ifndef LIVESTITCHER_BUNDLEFIXTURE_H
+#define LIVESTITCHER_BUNDLEFIXTURE_H
+#include <memory>
+#include <vector>
+
+#include <opencv2/core.hpp>
+#include <opencv2/imgproc.hpp>
+
+#include "core/bundlegeometry.h"
+
+namespace TestConfig{
+    static const cv::Size dims(320, 240);
+    static const int nr_cams = 3;
+    static const int overlap = 80;
+}
+
+/**
+ * Row of cameras with a fixed horizontal overlap and rounded masks.
+ */
+inline laz::BundleGeometryPtr make_geometry()
+{
+    std::vector<cv::Mat> mask_bundle(TestConfig::nr_cams);
+    std::vector<cv::Rect> corners_bundle(TestConfig::nr_cams);
+    std::vector<cv::Size> size_bundle(TestConfig::nr_cams, TestConfig::dims);
+    for (int i = 0; i < TestConfig::nr_cams; i++)
+    {
+        mask_bundle[i] = cv::Mat::zeros(TestConfig::dims, CV_8U);
+        cv::ellipse(mask_bundle[i], cv::Point(TestConfig::dims.width/2, TestConfig::dims.height/2),
+                    cv::Size(TestConfig::dims.width/2, TestConfig::dims.height*3/4), 0, 0, 360,
+                    cv::Scalar(255), cv::FILLED);
+        corners_bundle[i] = cv::Rect(cv::Point(i*(TestConfig::dims.width - TestConfig::overlap), i * 3),
+                                     TestConfig::dims);
+    }
+    return std::make_shared<const laz::BundleGeometry>(mask_bundle, corners_bundle, size_bundle);
+}
+
+inline std::vector<cv::Mat> make_images()
+{
+    cv::RNG rng(42);
+    std::vector<cv::Mat> img_bundle(TestConfig::nr_cams);
+    for (auto& img : img_bundle)
+    {
+        img.create(TestConfig::dims, CV_8UC3);
+        rng.fill(img, cv::RNG::UNIFORM, cv::Scalar::all(0), cv::Scalar::all(255));
+    }
+    return img_bundle;
+}
+
+#endif //LIVESTITCHER_BUNDLEFIXTURE_H
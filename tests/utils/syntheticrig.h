@@ -0,0 +1,131 @@
+#ifndef LIVESTITCHER_SYNTHETICRIG_H
+#define LIVESTITCHER_SYNTHETICRIG_H
+#include <cmath>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <assert.h>
+#include <opencv2/core.hpp>
+#include <opencv2/imgproc.hpp>
+
+#include "core/camera.h"
+#include "core/cvcamera.h"
+#include "core/camerastream.h"
+#include "core/streambundler.h"
+
+namespace SyntheticRigConfig{
+    static const float focal_ratio = 0.73f;
+    static const float radius_ratio = 0.73f;
+}
+
+/**
+ * Camera stream remapping the same source image on every read, so that a bundle never runs out of frames.
+ */
+class SyntheticStream : public laz::CameraStream {
+public:
+    SyntheticStream(laz::Camera const* _cam, const cv::Mat& _src) : laz::CameraStream(_cam), m_src(_src) {};
+
+    virtual cv::Mat read() const override
+    {
+        cv::Mat img;
+        m_cam->remap(m_src, img);
+        return img;
+    }
+
+    const cv::Mat& get_source() const { return m_src; }
+
+private:
+    const cv::Mat m_src;
+};
+
+/**
+ * Row of cylindrical cameras sharing the same intrinsics, yawed so that neighbours overlap by a fraction of
+ * their horizontal field of view. Each camera streams its own smoothed noise image.
+ */
+class SyntheticRig {
+public:
+    /**
+     * @param _nr_read_workers : Threads of the stream bundler reading the cameras in parallel, see StreamBundler
+     */
+    SyntheticRig(const int& _nr_cams, const cv::Size& _dims, const float& _overlap, const int& _nr_read_workers=0) :
+            m_dims(_dims)
+    {
+        assert(_nr_cams > 0);
+        assert(_overlap >= 0.f && _overlap < 1.f);
+
+        const float focal = SyntheticRigConfig::focal_ratio * _dims.width;
+        cv::Mat intrinsic = (cv::Mat_<float>(3, 3) << focal, 0.f, _dims.width/2.f,
+                                                       0.f, focal, _dims.height/2.f,
+                                                       0.f, 0.f, 1.f);
+        cv::Mat dist_coeffs = (cv::Mat_<float>(1, 5) << -0.09f, 0.07f, 0.f, 0.f, 0.f);
+
+        // Yaw step between neighbours leaving _overlap of the horizontal field of view in common
+        const float fov = 2.f * std::atan(_dims.width / (2.f * focal));
+        const float yaw_step = fov * (1.f - _overlap);
+
+        std::vector<laz::CameraStream*> streams;
+        for (int i = 0; i < _nr_cams; i++)
+        {
+            const float yaw = (i - (_nr_cams - 1) / 2.f) * yaw_step;
+            cv::Mat rotation = (cv::Mat_<float>(3, 3) << std::cos(yaw), 0.f, std::sin(yaw),
+                                                         0.f, 1.f, 0.f,
+                                                         -std::sin(yaw), 0.f, std::cos(yaw));
+
+            laz::IntrinsicCamera intrinsic_cam(laz::Camera("cam" + std::to_string(i), _dims), intrinsic, dist_coeffs);
+            laz::ExtrinsicCamera extrinsic_cam(intrinsic_cam, intrinsic);
+            laz::RotationCamera rot_cam(extrinsic_cam, rotation, SyntheticRigConfig::radius_ratio * _dims.width);
+            m_cameras.emplace_back(std::make_unique<laz::CvCylindricalCamera>(rot_cam));
+
+            m_streams.emplace_back(std::make_unique<SyntheticStream>(m_cameras.back().get(), make_image(_dims, i)));
+            streams.push_back(m_streams.back().get());
+        }
+
+        m_bundler = std::make_unique<laz::StreamBundler>(streams, _nr_read_workers);
+        m_bundler->connect();
+        m_img_bundle = m_bundler->read();
+    }
+
+    int size() const { return m_cameras.size(); }
+    cv::Size get_dims() const { return m_dims; }
+
+    const laz::CvCylindricalCamera& get_camera(const int& _idx) const { return *m_cameras.at(_idx); }
+    const SyntheticStream& get_stream(const int& _idx) const { return *m_streams.at(_idx); }
+    laz::StreamBundler* get_bundler() const { return m_bundler.get(); }
+    laz::BundleGeometryPtr get_geometry() const { return m_bundler->get_geometry(); }
+
+    /**
+     * Remapped images of the cameras, as read once from the bundle.
+     */
+    const std::vector<cv::Mat>& get_img_bundle() const { return m_img_bundle; }
+
+    /**
+     * Bytes of remapped images processed per bundle.
+     */
+    int64_t get_bundle_bytes() const
+    {
+        int64_t bytes = 0;
+        for (const auto& img : m_img_bundle)
+            bytes += img.total() * img.elemSize();
+        return bytes;
+    }
+
+private:
+    static cv::Mat make_image(const cv::Size& _dims, const int& _seed)
+    {
+        // Smoothed noise: keeps interpolation, gains and seam costs representative of natural images
+        cv::RNG rng(_seed + 1);
+        cv::Mat img(_dims, CV_8UC3);
+        rng.fill(img, cv::RNG::UNIFORM, cv::Scalar::all(0), cv::Scalar::all(255));
+        cv::GaussianBlur(img, img, cv::Size(7, 7), 0);
+        return img;
+    }
+
+    const cv::Size m_dims;
+    std::vector<std::unique_ptr<laz::CvCylindricalCamera>> m_cameras;
+    std::vector<std::unique_ptr<SyntheticStream>> m_streams;
+    std::unique_ptr<laz::StreamBundler> m_bundler;
+    std::vector<cv::Mat> m_img_bundle;
+};
+
+#endif //LIVESTITCHER_SYNTHETICRIG_H